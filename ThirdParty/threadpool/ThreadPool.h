@@ -5,6 +5,7 @@
 #include <mutex>
 #include <functional>
 #include <condition_variable>
+#include <type_traits>
 
 /**
  *  Set to 1 to use vector instead of queue for jobs container to improve
@@ -21,15 +22,20 @@
  *  Simple ThreadPool that creates `threadCount` threads upon its creation,
  *  and pulls from a queue to get new jobs.
  *
+ *  `Lock` guards the job queue and the job counter. Any Lockable type works
+ *  (e.g. the spinlocks in ../../sync); anything other than std::mutex waits
+ *  on std::condition_variable_any.
+ *
  *  This class requires a number of c++11 features be present in your compiler.
  */
-class ThreadPool
+template <typename Lock = std::mutex>
+class BasicThreadPool
 {
 public:
 #if CONTIGUOUS_JOBS_MEMORY
-    explicit ThreadPool(const unsigned int threadCount, const unsigned int jobsReserveCount = 0) :
+    explicit BasicThreadPool(const unsigned int threadCount, const unsigned int jobsReserveCount = 0) :
 #else
-    explicit ThreadPool(const unsigned int threadCount) :
+    explicit BasicThreadPool(const unsigned int threadCount) :
 #endif
         _jobsLeft(0),
         _bailout(false)
@@ -54,7 +60,7 @@ public:
     /**
      *  JoinAll on deconstruction
      */
-    ~ThreadPool()
+    ~BasicThreadPool()
     {
         JoinAll();
     }
@@ -68,7 +74,7 @@ public:
     {
         // scoped lock
         {
-            std::lock_guard<std::mutex> lock(_queueMutex);
+            std::lock_guard<Lock> lock(_queueMutex);
 #if CONTIGUOUS_JOBS_MEMORY
             _queue.push_back(job);
 #else
@@ -77,7 +83,7 @@ public:
         }
         // scoped lock
         {
-            std::lock_guard<std::mutex> lock(_jobsLeftMutex);
+            std::lock_guard<Lock> lock(_jobsLeftMutex);
             ++_jobsLeft;
         }
         _jobAvailableVar.notify_one();
@@ -93,7 +99,7 @@ public:
     {
         // scoped lock
         {
-            std::lock_guard<std::mutex> lock(_queueMutex);
+            std::lock_guard<Lock> lock(_queueMutex);
             if (_bailout)
             {
                 return;
@@ -121,7 +127,7 @@ public:
      */
     void WaitAll()
     {
-        std::unique_lock<std::mutex> lock(_jobsLeftMutex);
+        std::unique_lock<Lock> lock(_jobsLeftMutex);
         if (_jobsLeft > 0)
         {
             _waitVar.wait(lock, [this]
@@ -153,7 +159,7 @@ private:
 
             // scoped lock
             {
-                std::unique_lock<std::mutex> lock(_queueMutex);
+                std::unique_lock<Lock> lock(_queueMutex);
 
                 if (_bailout)
                 {
@@ -185,7 +191,7 @@ private:
 
             // scoped lock
             {
-                std::lock_guard<std::mutex> lock(_jobsLeftMutex);
+                std::lock_guard<Lock> lock(_jobsLeftMutex);
                 --_jobsLeft;
             }
 
@@ -200,13 +206,19 @@ private:
     std::queue<std::function<void()>> _queue;
 #endif
 
+    typedef typename std::conditional<std::is_same<Lock, std::mutex>::value,
+                                      std::condition_variable,
+                                      std::condition_variable_any>::type CondVar;
+
     int _jobsLeft;
     bool _bailout;
-    std::condition_variable _jobAvailableVar;
-    std::condition_variable _waitVar;
-    std::mutex _jobsLeftMutex;
-    std::mutex _queueMutex;
+    CondVar _jobAvailableVar;
+    CondVar _waitVar;
+    Lock _jobsLeftMutex;
+    Lock _queueMutex;
 };
 
+typedef BasicThreadPool<> ThreadPool;
+
 #undef CONTIGUOUS_JOBS_MEMORY
 #endif //CONCURRENT_THREADPOOL_H
@@ -0,0 +1,239 @@
+#include "gemm.h"
+
+#include <algorithm>
+#include <cstdlib> // for posix_memalign, free
+#include <new>
+
+#include <immintrin.h>
+
+namespace gemm {
+
+/*************
+ * 微内核 *
+ *************/
+// 不用任何扩展指令，编译器可以自己向量化
+static void kernelScalar(int kc, const double *a, const double *b, double *c, int ldc) {
+  double acc[4][4] = {};
+  for (int p = 0; p < kc; ++p, a += 4, b += 4) {
+    for (int i = 0; i < 4; ++i) {
+      for (int j = 0; j < 4; ++j) {
+        acc[i][j] += a[i] * b[j];
+      }
+    }
+  }
+  for (int i = 0; i < 4; ++i) {
+    for (int j = 0; j < 4; ++j) {
+      c[i * ldc + j] += acc[i][j];
+    }
+  }
+}
+
+// 每行两个 ymm: 读 B 的 8 个数，A 的每个数广播之后乘上去
+#define AVX2_FMA_ROW(i)                                                                            \
+  {                                                                                                \
+    __m256d ai = _mm256_broadcast_sd(a + i);                                                       \
+    c##i##0 = _mm256_fmadd_pd(ai, b0, c##i##0);                                                    \
+    c##i##1 = _mm256_fmadd_pd(ai, b1, c##i##1);                                                    \
+  }
+#define AVX2_STORE_ROW(i)                                                                          \
+  _mm256_storeu_pd(c + i * ldc, _mm256_add_pd(_mm256_loadu_pd(c + i * ldc), c##i##0));             \
+  _mm256_storeu_pd(c + i * ldc + 4, _mm256_add_pd(_mm256_loadu_pd(c + i * ldc + 4), c##i##1));
+
+__attribute__((target("avx2,fma"))) static void kernelAvx2(int kc, const double *a,
+                                                           const double *b, double *c, int ldc) {
+  __m256d c00 = _mm256_setzero_pd(), c01 = _mm256_setzero_pd();
+  __m256d c10 = _mm256_setzero_pd(), c11 = _mm256_setzero_pd();
+  __m256d c20 = _mm256_setzero_pd(), c21 = _mm256_setzero_pd();
+  __m256d c30 = _mm256_setzero_pd(), c31 = _mm256_setzero_pd();
+  __m256d c40 = _mm256_setzero_pd(), c41 = _mm256_setzero_pd();
+  __m256d c50 = _mm256_setzero_pd(), c51 = _mm256_setzero_pd();
+  for (int p = 0; p < kc; ++p, a += 6, b += 8) {
+    __m256d b0 = _mm256_load_pd(b);
+    __m256d b1 = _mm256_load_pd(b + 4);
+    AVX2_FMA_ROW(0)
+    AVX2_FMA_ROW(1)
+    AVX2_FMA_ROW(2)
+    AVX2_FMA_ROW(3)
+    AVX2_FMA_ROW(4)
+    AVX2_FMA_ROW(5)
+  }
+  AVX2_STORE_ROW(0)
+  AVX2_STORE_ROW(1)
+  AVX2_STORE_ROW(2)
+  AVX2_STORE_ROW(3)
+  AVX2_STORE_ROW(4)
+  AVX2_STORE_ROW(5)
+}
+
+// 每行两个 zmm，一共 16 个累加器
+#define AVX512_FMA_ROW(i)                                                                          \
+  {                                                                                                \
+    __m512d ai = _mm512_set1_pd(a[i]);                                                             \
+    c##i##0 = _mm512_fmadd_pd(ai, b0, c##i##0);                                                    \
+    c##i##1 = _mm512_fmadd_pd(ai, b1, c##i##1);                                                    \
+  }
+#define AVX512_STORE_ROW(i)                                                                        \
+  _mm512_storeu_pd(c + i * ldc, _mm512_add_pd(_mm512_loadu_pd(c + i * ldc), c##i##0));             \
+  _mm512_storeu_pd(c + i * ldc + 8, _mm512_add_pd(_mm512_loadu_pd(c + i * ldc + 8), c##i##1));
+
+__attribute__((target("avx512f"))) static void kernelAvx512(int kc, const double *a,
+                                                            const double *b, double *c, int ldc) {
+  __m512d c00 = _mm512_setzero_pd(), c01 = _mm512_setzero_pd();
+  __m512d c10 = _mm512_setzero_pd(), c11 = _mm512_setzero_pd();
+  __m512d c20 = _mm512_setzero_pd(), c21 = _mm512_setzero_pd();
+  __m512d c30 = _mm512_setzero_pd(), c31 = _mm512_setzero_pd();
+  __m512d c40 = _mm512_setzero_pd(), c41 = _mm512_setzero_pd();
+  __m512d c50 = _mm512_setzero_pd(), c51 = _mm512_setzero_pd();
+  __m512d c60 = _mm512_setzero_pd(), c61 = _mm512_setzero_pd();
+  __m512d c70 = _mm512_setzero_pd(), c71 = _mm512_setzero_pd();
+  for (int p = 0; p < kc; ++p, a += 8, b += 16) {
+    __m512d b0 = _mm512_load_pd(b);
+    __m512d b1 = _mm512_load_pd(b + 8);
+    AVX512_FMA_ROW(0)
+    AVX512_FMA_ROW(1)
+    AVX512_FMA_ROW(2)
+    AVX512_FMA_ROW(3)
+    AVX512_FMA_ROW(4)
+    AVX512_FMA_ROW(5)
+    AVX512_FMA_ROW(6)
+    AVX512_FMA_ROW(7)
+  }
+  AVX512_STORE_ROW(0)
+  AVX512_STORE_ROW(1)
+  AVX512_STORE_ROW(2)
+  AVX512_STORE_ROW(3)
+  AVX512_STORE_ROW(4)
+  AVX512_STORE_ROW(5)
+  AVX512_STORE_ROW(6)
+  AVX512_STORE_ROW(7)
+}
+
+/*************
+ * 选内核 *
+ *************/
+static const Kernel KERNEL_AVX512 = {"avx512", 8, 16, kernelAvx512};
+static const Kernel KERNEL_AVX2 = {"avx2", 6, 8, kernelAvx2};
+static const Kernel KERNEL_SCALAR = {"scalar", 4, 4, kernelScalar};
+
+int availableKernels(const Kernel **out, int max) {
+  int n = 0;
+  if (n < max && __builtin_cpu_supports("avx512f")) {
+    out[n++] = &KERNEL_AVX512;
+  }
+  if (n < max && __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+    out[n++] = &KERNEL_AVX2;
+  }
+  if (n < max) {
+    out[n++] = &KERNEL_SCALAR;
+  }
+  return n;
+}
+
+const Kernel &bestKernel() {
+  const Kernel *kernel;
+  availableKernels(&kernel, 1);
+  return *kernel;
+}
+
+/*************
+ * 打包 *
+ *************/
+static double *alignedDoubles(size_t n) {
+  void *mem = nullptr;
+  if (posix_memalign(&mem, 64, n * sizeof(double)) != 0) {
+    throw std::bad_alloc();
+  }
+  return static_cast<double *>(mem);
+}
+
+PackBuffers::PackBuffers() : a(alignedDoubles(MC * KC)), b(nullptr) {
+  try {
+    b = alignedDoubles(KC * NC);
+  } catch (...) {
+    free(a);
+    throw;
+  }
+}
+
+PackBuffers::~PackBuffers() {
+  free(a);
+  free(b);
+}
+
+void packA(const Kernel &kernel, int mc, int kc, const double *a, int lda, double *buf) {
+  const int mr = kernel.mr;
+  for (int i = 0; i < mc; i += mr) {
+    int rows = std::min(mr, mc - i);
+    for (int p = 0; p < kc; ++p) {
+      for (int r = 0; r < rows; ++r) {
+        buf[r] = a[(i + r) * lda + p];
+      }
+      for (int r = rows; r < mr; ++r) {
+        buf[r] = 0;
+      }
+      buf += mr;
+    }
+  }
+}
+
+void packB(const Kernel &kernel, int kc, int nc, const double *b, int ldb, double *buf) {
+  const int nr = kernel.nr;
+  for (int j = 0; j < nc; j += nr) {
+    int cols = std::min(nr, nc - j);
+    for (int p = 0; p < kc; ++p) {
+      const double *row = b + p * ldb + j;
+      for (int c = 0; c < cols; ++c) {
+        buf[c] = row[c];
+      }
+      for (int c = cols; c < nr; ++c) {
+        buf[c] = 0;
+      }
+      buf += nr;
+    }
+  }
+}
+
+void macroKernel(const Kernel &kernel, int mc, int nc, int kc, const double *pa, const double *pb,
+                 double *c, int ldc) {
+  const int mr = kernel.mr, nr = kernel.nr;
+  alignas(64) double edge[16 * 16]; // 最大的 MR x NR
+  for (int j = 0; j < nc; j += nr) {
+    int cols = std::min(nr, nc - j);
+    const double *b = pb + j * kc;
+    for (int i = 0; i < mc; i += mr) {
+      int rows = std::min(mr, mc - i);
+      const double *a = pa + i * kc;
+      double *cij = c + i * ldc + j;
+      if (rows == mr && cols == nr) {
+        kernel.fn(kc, a, b, cij, ldc);
+        continue;
+      }
+      // 边角: 补 0 的部分算到临时数组里，只把有效的部分加回 C
+      std::fill(edge, edge + mr * nr, 0.0);
+      kernel.fn(kc, a, b, edge, nr);
+      for (int r = 0; r < rows; ++r) {
+        for (int s = 0; s < cols; ++s) {
+          cij[r * ldc + s] += edge[r * nr + s];
+        }
+      }
+    }
+  }
+}
+
+void multiply(const Kernel &kernel, int m, int n, int k, const double *a, int lda, const double *b,
+              int ldb, double *c, int ldc, PackBuffers &buffers) {
+  for (int jc = 0; jc < n; jc += NC) {
+    int nc = std::min(NC, n - jc);
+    for (int pc = 0; pc < k; pc += KC) {
+      int kc = std::min(KC, k - pc);
+      packB(kernel, kc, nc, b + pc * ldb + jc, ldb, buffers.b);
+      for (int ic = 0; ic < m; ic += MC) {
+        int mc = std::min(MC, m - ic);
+        packA(kernel, mc, kc, a + ic * lda + pc, lda, buffers.a);
+        macroKernel(kernel, mc, nc, kc, buffers.a, buffers.b, c + ic * ldc + jc, ldc);
+      }
+    }
+  }
+}
+
+} // namespace gemm
@@ -0,0 +1,64 @@
+#pragma once
+// 打包的分块矩阵乘法 C += A * B，所有矩阵按行存储，lda/ldb/ldc 是一行的长度
+//
+// 按 Goto/BLIS 的方式分三层:
+//   1. B 按 KC 行 x NC 列分块，打包成连续的 NR 列宽的竖条 (放在 L3)
+//   2. A 按 MC 行 x KC 列分块，打包成连续的 MR 行高的横条 (放在 L2)
+//   3. 微内核把 MR x NR 个结果一直放在寄存器中，沿 k 方向每次读 A 的 MR 个数、B 的 NR 个数，
+//      只在最后写回 C 一次 (multiple_L1d_opt 每次都要读写 slice_res)
+// 不足 MR/NR 的边角在打包时补 0，算到临时的 MR x NR 中再加回 C
+//
+// 微内核运行时按 CPU 选:
+//   avx512  8 x 16，16 个 zmm 累加器
+//   avx2    6 x 8，12 个 ymm 累加器 (需要 FMA)
+//   scalar  4 x 4，不用任何扩展指令
+#include <cstddef> // for size_t
+
+namespace gemm {
+
+// 分块大小，MC 和 NC 是所有内核的 MR/NR 的倍数
+const int MC = 96;
+const int KC = 256;
+const int NC = 2048;
+
+// c[MR x NR] += a * b，a 是打包好的 MR 行 x kc 列，b 是打包好的 kc 行 x NR 列
+typedef void (*MicroKernel)(int kc, const double *a, const double *b, double *c, int ldc);
+
+struct Kernel {
+  const char *name;
+  int mr;
+  int nr;
+  MicroKernel fn;
+};
+
+// 这台机器支持的内核，从快到慢排列，最后一个总是 scalar
+// 返回个数
+int availableKernels(const Kernel **out, int max);
+// 最快的那个
+const Kernel &bestKernel();
+
+// 打包用的缓冲区，64 字节对齐，一个线程一份
+class PackBuffers {
+public:
+  PackBuffers();
+  ~PackBuffers();
+  PackBuffers(const PackBuffers &) = delete;
+  PackBuffers &operator=(const PackBuffers &) = delete;
+
+  double *a; // MC x KC
+  double *b; // KC x NC
+};
+
+// 把 A 的 mc x kc 块打包成 MR 行高的横条，每条内按列连续
+void packA(const Kernel &kernel, int mc, int kc, const double *a, int lda, double *buf);
+// 把 B 的 kc x nc 块打包成 NR 列宽的竖条，每条内按行连续
+void packB(const Kernel &kernel, int kc, int nc, const double *b, int ldb, double *buf);
+// 打包好的 mc x kc 乘以 kc x nc，加到 C 上
+void macroKernel(const Kernel &kernel, int mc, int nc, int kc, const double *pa, const double *pb,
+                 double *c, int ldc);
+
+// 单线程，C(m x n) += A(m x k) * B(k x n)
+void multiply(const Kernel &kernel, int m, int n, int k, const double *a, int lda, const double *b,
+              int ldb, double *c, int ldc, PackBuffers &buffers);
+
+} // namespace gemm
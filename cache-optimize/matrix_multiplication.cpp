@@ -1,8 +1,15 @@
-// g++ -std=c++0x -DCLS=$(getconf LEVEL1_DCACHE_LINESIZE) -o matrix
-// matrix_multiplication.cpp
+// g++ -std=c++0x -O2 -DCLS=$(getconf LEVEL1_DCACHE_LINESIZE) -o matrix
+// matrix_multiplication.cpp gemm.cpp parallel_gemm.cpp -lpthread
+#include <algorithm>
 #include <chrono>
+#include <cmath>
 #include <iostream>
 #include <random>
+#include <thread>
+#include <vector>
+
+#include "gemm.h"
+#include "parallel_gemm.h"
 
 #define SM (CLS / sizeof(double)) // for L1 data optimization
 
@@ -17,7 +24,7 @@ bool checkAnswer() {
   for (int i = 0; i < MATRIX_SIZE; i++) {
     for (int j = 0; j < MATRIX_SIZE; j++) {
       // 比较 double 不能直接用 ==
-      if (abs(result[i][j] - correct_result[i][j]) > 1e-6) {
+      if (std::fabs(result[i][j] - correct_result[i][j]) > 1e-6) {
         std::cout << "Wrong answer: " << result[i][j]
                   << " != " << correct_result[i][j] << " at [" << i << ", " << j
                   << "]" << std::endl;
@@ -129,9 +136,85 @@ void multiple_L1d_opt() {
   clearResult();
 }
 
+void multiple_packed_simd() {
+  // 打包 + 寄存器分块 + SIMD 微内核，见 gemm.h
+  // 每个这台机器支持的内核都跑一次，第一个就是运行时默认选的
+  const gemm::Kernel *kernels[4];
+  int n = gemm::availableKernels(kernels, 4);
+  gemm::PackBuffers buffers;
+  for (int i = 0; i < n; ++i) {
+    const gemm::Kernel &kernel = *kernels[i];
+    // 先跑一次不计时，打包缓冲区第一次用时的缺页不算进去
+    gemm::multiply(kernel, MATRIX_SIZE, MATRIX_SIZE, MATRIX_SIZE, &matrix1[0][0], MATRIX_SIZE,
+                   &matrix2[0][0], MATRIX_SIZE, &result[0][0], MATRIX_SIZE, buffers);
+    clearResult();
+    auto multiple_start = std::chrono::steady_clock::now();
+    gemm::multiply(kernel, MATRIX_SIZE, MATRIX_SIZE, MATRIX_SIZE, &matrix1[0][0], MATRIX_SIZE,
+                   &matrix2[0][0], MATRIX_SIZE, &result[0][0], MATRIX_SIZE, buffers);
+    auto multiple_end = std::chrono::steady_clock::now();
+    std::chrono::duration<double> diff = multiple_end - multiple_start;
+    double gflops = 2.0 * MATRIX_SIZE * MATRIX_SIZE * MATRIX_SIZE / diff.count() / 1e9;
+    std::cout << "packed " << kernel.name << " " << kernel.mr << "x" << kernel.nr
+              << " multiple cost: " << diff.count() << " seconds, " << gflops << " GFLOPS"
+              << std::endl;
+    checkAnswer();
+    clearResult();
+  }
+}
+
+// 一次多线程乘法的耗时，先跑一次不计时
+double timeParallel(ThreadPool &pool, gemm::PerThreadBuffers &buffers, gemm::Partition partition,
+                    const gemm::Kernel &kernel) {
+  gemm::multiplyParallel(pool, buffers, partition, kernel, MATRIX_SIZE, MATRIX_SIZE, MATRIX_SIZE,
+                         &matrix1[0][0], MATRIX_SIZE, &matrix2[0][0], MATRIX_SIZE, &result[0][0],
+                         MATRIX_SIZE);
+  clearResult();
+  auto multiple_start = std::chrono::steady_clock::now();
+  gemm::multiplyParallel(pool, buffers, partition, kernel, MATRIX_SIZE, MATRIX_SIZE, MATRIX_SIZE,
+                         &matrix1[0][0], MATRIX_SIZE, &matrix2[0][0], MATRIX_SIZE, &result[0][0],
+                         MATRIX_SIZE);
+  auto multiple_end = std::chrono::steady_clock::now();
+  std::chrono::duration<double> diff = multiple_end - multiple_start;
+  return diff.count();
+}
+
+void multiple_parallel() {
+  // 线程数 1, 2, 4 ... 最后一个是核数，1D 和 2D 两种切法
+  // 加速比是和同一种切法的 1 个线程比，效率 = 加速比 / 线程数
+  const gemm::Kernel &kernel = gemm::bestKernel();
+  int cores = std::max(1u, std::thread::hardware_concurrency());
+  std::vector<int> counts;
+  for (int n = 1; n < cores; n <<= 1) {
+    counts.push_back(n);
+  }
+  counts.push_back(cores);
+
+  const gemm::Partition partitions[] = {gemm::PARTITION_1D, gemm::PARTITION_2D};
+  const char *names[] = {"1D", "2D"};
+  for (int p = 0; p < 2; ++p) {
+    double single = 0;
+    for (int threads : counts) {
+      ThreadPool pool(threads);
+      gemm::PerThreadBuffers buffers = gemm::makeBuffers(threads);
+      double secs = timeParallel(pool, buffers, partitions[p], kernel);
+      if (threads == 1) {
+        single = secs;
+      }
+      double gflops = 2.0 * MATRIX_SIZE * MATRIX_SIZE * MATRIX_SIZE / secs / 1e9;
+      std::cout << "parallel " << names[p] << " " << kernel.name << " " << threads
+                << " threads: " << secs << " seconds, " << gflops << " GFLOPS, speedup "
+                << single / secs << ", efficiency " << single / secs / threads << std::endl;
+      checkAnswer();
+      clearResult();
+    }
+  }
+}
+
 int main() {
   initMat();
   multiple_no_opt();
   multiple_transpose_opt();
   multiple_L1d_opt();
+  multiple_packed_simd();
+  multiple_parallel();
 }
@@ -0,0 +1,55 @@
+#include "parallel_gemm.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+
+namespace gemm {
+
+PerThreadBuffers makeBuffers(int threads) {
+  PerThreadBuffers buffers;
+  for (int i = 0; i < threads; ++i) {
+    buffers.push_back(std::unique_ptr<PackBuffers>(new PackBuffers));
+  }
+  return buffers;
+}
+
+void multiplyParallel(ThreadPool &pool, PerThreadBuffers &buffers, Partition partition,
+                      const Kernel &kernel, int m, int n, int k, const double *a, int lda,
+                      const double *b, int ldb, double *c, int ldc) {
+  assert(!buffers.empty());
+  // C += A * B，没有元素或者 k 为 0 时什么都不用做，也避免下面除以 0
+  if (m == 0 || n == 0 || k == 0) {
+    return;
+  }
+  const int threads = static_cast<int>(buffers.size());
+  int tileM, tileN;
+  if (partition == PARTITION_1D) {
+    // 每个线程一条，行数向上取到 MR 的整数倍，微内核只在最后一条遇到边角
+    tileM = (m + threads - 1) / threads;
+    tileM = (tileM + kernel.mr - 1) / kernel.mr * kernel.mr;
+    tileN = n;
+  } else {
+    tileM = MC;
+    tileN = TILE_N;
+  }
+  const int tileRows = (m + tileM - 1) / tileM;
+  const int tileCols = (n + tileN - 1) / tileN;
+  const int tiles = tileRows * tileCols;
+
+  std::atomic<int> next(0);
+  for (int t = 0; t < threads; ++t) {
+    PackBuffers *buf = buffers[t].get();
+    pool.AddJob([&, buf] {
+      for (int tile = next.fetch_add(1); tile < tiles; tile = next.fetch_add(1)) {
+        // 同一行的块挨着领，相邻的线程用到的是同一段 A
+        int i = tile / tileCols * tileM, j = tile % tileCols * tileN;
+        int rows = std::min(tileM, m - i), cols = std::min(tileN, n - j);
+        multiply(kernel, rows, cols, k, a + i * lda, lda, b + j, ldb, c + i * ldc + j, ldc, *buf);
+      }
+    });
+  }
+  pool.WaitAll();
+}
+
+} // namespace gemm
@@ -0,0 +1,39 @@
+#pragma once
+// 多线程的分块矩阵乘法，C += A * B，在 gemm.h 的单线程版本上:
+//   ThreadPool pool(threads);
+//   gemm::PerThreadBuffers buffers = gemm::makeBuffers(threads);
+//   gemm::multiplyParallel(pool, buffers, gemm::PARTITION_2D, gemm::bestKernel(), m, n, k, ...);
+//
+// C 切成互不重叠的块，往线程池里放 threads 个任务 (一个线程一个)，
+// 每个任务用自己的打包缓冲区，从一个原子计数器领下一块，领完为止。
+// 不同的块写 C 的不同部分，任务之间除了领块不需要同步。
+//
+// 两种切法:
+//   PARTITION_1D  按行切成 threads 条，每条 MR 的整数倍高、N 列宽；
+//                 每个线程只打包一次自己要用的 B，但行数不能整除时最后一条会短很多
+//   PARTITION_2D  切成 MC 行 x TILE_N 列的小块，块比线程多得多，先做完的线程多领几块；
+//                 每块都要重新打包自己那部分的 A 和 B
+#include <memory>
+#include <vector>
+
+#include "../ThirdParty/threadpool/ThreadPool.h"
+#include "gemm.h"
+
+namespace gemm {
+
+// 2D 切分时每块的列数，是所有内核 NR 的倍数
+const int TILE_N = 256;
+
+enum Partition { PARTITION_1D, PARTITION_2D };
+
+typedef std::vector<std::unique_ptr<PackBuffers> > PerThreadBuffers;
+
+PerThreadBuffers makeBuffers(int threads);
+
+// 用 buffers.size() 个线程计算 C(m x n) += A(m x k) * B(k x n)，返回时已经算完
+// buffers 不能为空，pool 中至少要有这么多线程，而且这期间不能有别的任务 (用 WaitAll 等待)
+void multiplyParallel(ThreadPool &pool, PerThreadBuffers &buffers, Partition partition,
+                      const Kernel &kernel, int m, int n, int k, const double *a, int lda,
+                      const double *b, int ldb, double *c, int ldc);
+
+} // namespace gemm
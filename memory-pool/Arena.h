@@ -0,0 +1,144 @@
+#pragma once
+#include <cstddef> // for size_t, max_align_t
+#include <cstdint> // for uintptr_t
+#include <new>
+#include <utility> // for std::forward
+
+// 单调递增的内存区域 (bump pointer arena)
+//
+// 适合一批同时死亡的短命对象，比如处理一个请求时分配的所有东西:
+// 分配只是把指针往后推，单个对象不能释放，请求结束时 reset() 一次性全部回收。
+// Block 的管理沿用 MemoryPool 的做法: 每个 Block 开头记录上一个 Block，头插成链表。
+// reset()/rewind() 回收的 Block 放进备用链表，下一个请求直接复用，不再向系统申请。
+//
+// 不是线程安全的，一般每个线程/每个请求一个
+class Arena {
+public:
+  // 某个时刻的分配位置，rewind 回到这里
+  struct Marker {
+    void *block;
+    char *cur;
+  };
+
+  explicit Arena(size_t blockSize = 64 * 1024) noexcept
+      : blockSize_(blockSize), current_(nullptr), spare_(nullptr),
+        cur_(nullptr), end_(nullptr) {}
+
+  Arena(const Arena &) = delete;
+  Arena &operator=(const Arena &) = delete;
+
+  ~Arena() noexcept { release(); }
+
+  /*******
+  * 分配 *
+  *******/
+  inline void *allocate(size_t bytes, size_t align = alignof(std::max_align_t)) {
+    char *p = alignUp_(cur_, align);
+    // 对齐可能把 p 推到 end_ 之后，这时 end_ - p 是负数，要先比较指针
+    if (p == nullptr || p > end_ || bytes > static_cast<size_t>(end_ - p)) {
+      newBlock_(bytes + align - 1);
+      p = alignUp_(cur_, align);
+    }
+    cur_ = p + bytes;
+    return p;
+  }
+
+  // 在 arena 上构造对象，析构函数不会被调用，只适合不持有其他资源的类型
+  template <typename T, typename... Args> inline T *create(Args &&... args) {
+    return new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+  }
+
+  /***********
+  * 回收内存 *
+  ***********/
+  inline Marker mark() const noexcept {
+    Marker m = {current_, cur_};
+    return m;
+  }
+
+  // 回到 mark() 时的位置，之后分配的内存全部失效
+  void rewind(Marker m) noexcept {
+    while (current_ != m.block) {
+      Block_ *block = current_;
+      current_ = block->prev;
+      recycle_(block);
+    }
+    cur_ = m.cur;
+    end_ = current_ == nullptr ? nullptr : blockEnd_(current_);
+  }
+
+  // 回到最开始，所有 Block 留着复用
+  inline void reset() noexcept {
+    Marker m = {nullptr, nullptr};
+    rewind(m);
+  }
+
+  // 把所有 Block 还给系统
+  void release() noexcept {
+    reset();
+    while (spare_ != nullptr) {
+      Block_ *block = spare_;
+      spare_ = block->prev;
+      ::operator delete(reinterpret_cast<void *>(block));
+    }
+  }
+
+  // 当前正在使用的 Block 的总大小
+  size_t capacity() const noexcept {
+    size_t total = 0;
+    for (Block_ *block = current_; block != nullptr; block = block->prev) {
+      total += block->size;
+    }
+    return total;
+  }
+
+private:
+  // 每个 Block 开头的头部，之后才是可分配的内存
+  struct alignas(std::max_align_t) Block_ {
+    Block_ *prev; // 上一个 Block，在备用链表中则是下一个备用 Block
+    size_t size;  // 整个 Block 的大小，包括头部
+  };
+
+  size_t blockSize_;
+  Block_ *current_; // 正在分配的 Block
+  Block_ *spare_;   // reset/rewind 回收的标准大小的 Block
+  char *cur_;
+  char *end_;
+
+  static inline char *alignUp_(char *p, size_t align) noexcept {
+    uintptr_t addr = reinterpret_cast<uintptr_t>(p);
+    return reinterpret_cast<char *>((addr + align - 1) & ~(uintptr_t)(align - 1));
+  }
+
+  static inline char *blockEnd_(Block_ *block) noexcept {
+    return reinterpret_cast<char *>(block) + block->size;
+  }
+
+  // 放得下 bytes 的新 Block，优先用备用的，太大的请求单独申请一个 Block
+  void newBlock_(size_t bytes) {
+    Block_ *block;
+    if (bytes <= blockSize_ - sizeof(Block_) && spare_ != nullptr) {
+      block = spare_;
+      spare_ = block->prev;
+    } else {
+      size_t size = bytes + sizeof(Block_) > blockSize_ ? bytes + sizeof(Block_)
+                                                        : blockSize_;
+      block = reinterpret_cast<Block_ *>(::operator new(size));
+      block->size = size;
+    }
+    block->prev = current_;
+    current_ = block;
+    cur_ = reinterpret_cast<char *>(block + 1);
+    end_ = blockEnd_(block);
+  }
+
+  // 标准大小的放进备用链表，单独申请的大 Block 直接释放
+  inline void recycle_(Block_ *block) noexcept {
+    if (block->size == blockSize_) {
+      block->prev = spare_;
+      spare_ = block;
+    } else {
+      ::operator delete(reinterpret_cast<void *>(block));
+    }
+  }
+};
@@ -0,0 +1,205 @@
+#pragma once
+#include <cstddef> // for size_t
+#include <cstdint> // for uintptr_t
+#include <new>
+#include <utility> // for std::swap
+#include <vector>
+
+#include <linux/mempolicy.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+// 给 MemoryPool 用的 Block 来源:
+//   MemoryPool<T, BlockSize, MmapBlockSource> pool(MmapBlockSource(options));
+//
+// 默认的 HeapBlockSource 每个 Block 都单独 ::operator new，几百万个对象时
+// 内存池分散在大量 4 KB 的页上，TLB 不够用；Block 落在哪个 NUMA 节点也取决于
+// 当时分配它的线程跑在哪里。MmapBlockSource 一次 mmap 一大块 region，再切成 Block:
+//   - region 可以使用大页，同样大小的内存只占用很少的 TLB 项
+//   - region 可以用 mbind 绑定到某个 NUMA 节点，或者由当前线程先全部写一遍 (first touch)
+// 机器不支持时逐级退回，不会失败
+
+// 大页的使用方式
+enum class HugePages {
+  None,        // 普通 4 KB 页
+  Transparent, // region 按 2 MB 对齐并 madvise(MADV_HUGEPAGE)，由内核的 THP 决定
+  Explicit     // MAP_HUGETLB，需要事先预留 (vm.nr_hugepages)，失败时退回 Transparent
+};
+
+struct MmapOptions {
+  size_t regionSize;  // 每次 mmap 的大小，至少放得下一个 Block
+  HugePages huge;
+  int node;           // 绑定到哪个 NUMA 节点，-1 表示不绑定
+  bool prefault;      // mmap 之后由当前线程把每一页写一遍
+
+  MmapOptions()
+      : regionSize(4 << 20), huge(HugePages::Transparent), node(-1),
+        prefault(false) {}
+};
+
+class MmapBlockSource {
+public:
+  static const size_t HUGE_PAGE_SIZE = 2 << 20;
+
+  explicit MmapBlockSource(const MmapOptions &options = MmapOptions()) noexcept
+      : options_(options), used_(options.huge), cur_(nullptr), end_(nullptr) {}
+
+  // 拷贝只拷贝配置 (MemoryPool 拷贝/rebind 时)，各自 mmap 自己的 region
+  MmapBlockSource(const MmapBlockSource &other) noexcept
+      : MmapBlockSource(other.options_) {}
+
+  MmapBlockSource(MmapBlockSource &&other) noexcept
+      : MmapBlockSource(other.options_) {
+    swap(other);
+  }
+
+  MmapBlockSource &operator=(MmapBlockSource other) noexcept {
+    swap(other);
+    return *this;
+  }
+
+  ~MmapBlockSource() noexcept {
+    for (const Region_ &region : regions_) {
+      munmap(region.addr, region.size);
+    }
+  }
+
+  void swap(MmapBlockSource &other) noexcept {
+    std::swap(options_, other.options_);
+    std::swap(used_, other.used_);
+    std::swap(regions_, other.regions_);
+    std::swap(freed_, other.freed_);
+    std::swap(cur_, other.cur_);
+    std::swap(end_, other.end_);
+  }
+
+  inline const MmapOptions &options() const noexcept { return options_; }
+  // 实际用上的大页方式，退回之后会和 options().huge 不同
+  inline HugePages hugePages() const noexcept { return used_; }
+
+  void *allocateBlock(size_t size) {
+    for (size_t i = freed_.size(); i-- > 0;) {
+      if (freed_[i].size == size) {
+        void *block = freed_[i].addr;
+        freed_.erase(freed_.begin() + i);
+        return block;
+      }
+    }
+    if (cur_ == nullptr || size > static_cast<size_t>(end_ - cur_)) {
+      newRegion_(size);
+    }
+    void *block = cur_;
+    cur_ += size;
+    return block;
+  }
+
+  // MemoryPool::trim 还回来的 Block: 物理页用 MADV_DONTNEED 还给系统，
+  // 地址范围留着给下一次 allocateBlock，region 在析构时才 munmap
+  // 只释放 Block 内完整的页。使用大页时页是 2 MB: 对 THP 只 DONTNEED 一个大页的一部分会把它
+  // 拆成 4 KB 的页，TLB 的好处就没了；hugetlb 的页不能拆，范围也要按 2 MB 对齐 (老内核不支持，什么都不做)。
+  // 所以请求了大页时 (按 options().huge，退回过的 region 也一样) 小于 2 MB 的 Block 只留着复用，不还给系统
+  void deallocateBlock(void *block, size_t size) {
+    uintptr_t page = options_.huge == HugePages::None ? sysconf(_SC_PAGESIZE) : HUGE_PAGE_SIZE;
+    uintptr_t begin = (reinterpret_cast<uintptr_t>(block) + page - 1) & ~(page - 1);
+    uintptr_t end = (reinterpret_cast<uintptr_t>(block) + size) & ~(page - 1);
+    if (begin < end) {
+      madvise(reinterpret_cast<void *>(begin), end - begin, MADV_DONTNEED);
+    }
+    Region_ freed = {block, size};
+    freed_.push_back(freed);
+  }
+
+  // 内存池析构时: 整个 region 马上会在析构函数中 munmap，不需要逐个 Block 处理
+  inline void releaseBlock(void *, size_t) noexcept {}
+
+private:
+  struct Region_ {
+    void *addr;
+    size_t size;
+  };
+
+  MmapOptions options_;
+  HugePages used_;
+  std::vector<Region_> regions_;
+  std::vector<Region_> freed_; // 还回来的 Block
+  char *cur_; // 当前 region 中下一个 Block 的位置
+  char *end_;
+
+  static inline size_t roundUp_(size_t n, size_t align) {
+    return (n + align - 1) / align * align;
+  }
+
+  void newRegion_(size_t blockSize) {
+    size_t size = options_.regionSize > blockSize ? options_.regionSize : blockSize;
+    void *addr = MAP_FAILED;
+
+    if (used_ == HugePages::Explicit) {
+      size = roundUp_(size, HUGE_PAGE_SIZE);
+      addr = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                  MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+      if (addr == MAP_FAILED) {
+        used_ = HugePages::Transparent; // 没有预留大页
+      }
+    }
+    if (addr == MAP_FAILED && used_ == HugePages::Transparent) {
+      size = roundUp_(size, HUGE_PAGE_SIZE);
+      addr = mapAligned_(size, HUGE_PAGE_SIZE);
+      if (addr != MAP_FAILED && madvise(addr, size, MADV_HUGEPAGE) != 0) {
+        used_ = HugePages::None; // 内核不支持 THP，映射本身仍然可用
+      }
+    }
+    if (addr == MAP_FAILED) {
+      size = roundUp_(size, sysconf(_SC_PAGESIZE));
+      addr = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                  MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+      if (addr == MAP_FAILED) {
+        throw std::bad_alloc();
+      }
+    }
+
+    if (options_.node >= 0) {
+      bind_(addr, size, options_.node);
+    }
+    if (options_.prefault) {
+      size_t page = sysconf(_SC_PAGESIZE);
+      for (size_t off = 0; off < size; off += page) {
+        static_cast<volatile char *>(addr)[off] = 0;
+      }
+    }
+
+    Region_ region = {addr, size};
+    regions_.push_back(region);
+    cur_ = static_cast<char *>(addr);
+    end_ = cur_ + size;
+  }
+
+  // 多映射 align 字节，再把首尾多出来的部分 munmap 掉
+  static void *mapAligned_(size_t size, size_t align) {
+    void *raw = mmap(nullptr, size + align, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (raw == MAP_FAILED) {
+      return MAP_FAILED;
+    }
+    uintptr_t start = reinterpret_cast<uintptr_t>(raw);
+    uintptr_t aligned = (start + align - 1) & ~(uintptr_t)(align - 1);
+    if (aligned != start) {
+      munmap(raw, aligned - start);
+    }
+    size_t tail = start + size + align - (aligned + size);
+    if (tail != 0) {
+      munmap(reinterpret_cast<void *>(aligned + size), tail);
+    }
+    return reinterpret_cast<void *>(aligned);
+  }
+
+  // 优先从 node 分配物理页，node 上内存不够时仍然可以用其他节点
+  // 直接调用系统调用，不依赖 libnuma；单节点的机器或内核不支持时什么都不做
+  static void bind_(void *addr, size_t size, int node) {
+    const size_t bits = sizeof(unsigned long) * 8;
+    std::vector<unsigned long> mask(node / bits + 1, 0);
+    mask[node / bits] = 1UL << (node % bits);
+    syscall(SYS_mbind, addr, size, MPOL_PREFERRED, mask.data(),
+            mask.size() * bits + 1, 0);
+  }
+};
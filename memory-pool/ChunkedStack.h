@@ -0,0 +1,138 @@
+#pragma once
+#include <cstddef> // for size_t
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility> // for std::move, std::forward
+
+// 分段连续的栈:
+//   ChunkedStack<int, MemoryPool<int> > stack;
+//   stack.emplace(1);
+//   int x = stack.pop();
+//
+// StackAlloc 每 push 一个元素就分配一个节点，节点之间用 prev 指针连起来，
+// 即使用 MemoryPool，每个节点也多占一个指针，pop 时还要追一次指针。
+// 这里的元素连续存放在固定大小的 Chunk 中，只有 Chunk 之间用指针连起来，
+// Chunk 和 StackAlloc 的节点一样从 rebind 到 Chunk 类型的 Alloc 分配，一次一个。
+//
+// 最后一个 Chunk 空了之后不会马上还给 Alloc，而是留一个备用，
+// 在 Chunk 边界上来回 push/pop 时不会反复分配和释放
+//
+// ChunkBytes 是每个 Chunk 的大小 (包括一个指针的头部)，至少放一个元素
+template <class T, class Alloc = std::allocator<T>, size_t ChunkBytes = 1024>
+class ChunkedStack {
+public:
+  // 每个 Chunk 中的元素个数
+  static const size_t CHUNK_SIZE = ChunkBytes > sizeof(void *) + sizeof(T)
+                                       ? (ChunkBytes - sizeof(void *)) / sizeof(T)
+                                       : 1;
+
+  ChunkedStack() noexcept : top_(nullptr), used_(0), size_(0), spare_(nullptr) {}
+
+  ChunkedStack(const ChunkedStack &) = delete;
+  ChunkedStack &operator=(const ChunkedStack &) = delete;
+
+  ~ChunkedStack() noexcept {
+    clear();
+    if (spare_ != nullptr) {
+      freeChunk_(spare_);
+    }
+  }
+
+  inline bool empty() const noexcept { return size_ == 0; }
+  inline size_t size() const noexcept { return size_; }
+
+  // 栈顶元素，栈不能为空
+  inline T &top() noexcept { return *slot_(top_, used_ - 1); }
+  inline const T &top() const noexcept { return *slot_(top_, used_ - 1); }
+
+  inline void push(const T &element) { emplace(element); }
+  inline void push(T &&element) { emplace(std::move(element)); }
+
+  // 直接在栈顶构造元素
+  template <class... Args> inline void emplace(Args &&... args) {
+    if (top_ != nullptr && used_ < CHUNK_SIZE) {
+      ::new (slot_(top_, used_)) T(std::forward<Args>(args)...);
+      used_++;
+    } else {
+      emplaceInNewChunk_(std::forward<Args>(args)...);
+    }
+    size_++;
+  }
+
+  // 把栈顶元素移出来，栈不能为空
+  inline T pop() {
+    T *p = slot_(top_, used_ - 1);
+    T result(std::move(*p));
+    p->~T();
+    if (--used_ == 0) {
+      dropChunk_();
+    }
+    size_--;
+    return result;
+  }
+
+  // 析构所有元素并释放所有 Chunk (备用的 Chunk 保留)
+  void clear() noexcept {
+    while (top_ != nullptr) {
+      for (size_t i = used_; i-- > 0;) {
+        slot_(top_, i)->~T();
+      }
+      Chunk_ *prev = top_->prev;
+      freeChunk_(top_);
+      top_ = prev;
+      used_ = CHUNK_SIZE;
+    }
+    used_ = 0;
+    size_ = 0;
+  }
+
+private:
+  struct Chunk_ {
+    Chunk_ *prev;
+    typename std::aligned_storage<sizeof(T), alignof(T)>::type data[CHUNK_SIZE];
+  };
+  typedef typename Alloc::template rebind<Chunk_>::other allocator;
+
+  allocator allocator_;
+  Chunk_ *top_;   // 栈顶所在的 Chunk
+  size_t used_;   // top_ 中的元素个数，top_ 不为空时至少为 1
+  size_t size_;
+  Chunk_ *spare_; // 备用的空 Chunk
+
+  static inline T *slot_(Chunk_ *chunk, size_t i) noexcept {
+    return reinterpret_cast<T *>(&chunk->data[i]);
+  }
+
+  inline void freeChunk_(Chunk_ *chunk) noexcept { allocator_.deallocate(chunk, 1); }
+
+  // 栈顶的 Chunk 满了: 在新的 Chunk 中构造成功之后才把它挂上去，构造时抛出异常栈不变
+  template <class... Args> void emplaceInNewChunk_(Args &&... args) {
+    Chunk_ *chunk = spare_;
+    if (chunk != nullptr) {
+      spare_ = nullptr;
+    } else {
+      chunk = allocator_.allocate(1);
+    }
+    try {
+      ::new (slot_(chunk, 0)) T(std::forward<Args>(args)...);
+    } catch (...) {
+      spare_ = chunk;
+      throw;
+    }
+    chunk->prev = top_;
+    top_ = chunk;
+    used_ = 1;
+  }
+
+  // 栈顶的 Chunk 空了: 留作备用，原来的备用 Chunk 还给 Alloc
+  void dropChunk_() noexcept {
+    Chunk_ *chunk = top_;
+    top_ = chunk->prev;
+    used_ = top_ != nullptr ? CHUNK_SIZE : 0;
+    if (spare_ != nullptr) {
+      freeChunk_(spare_);
+    }
+    spare_ = chunk;
+  }
+};
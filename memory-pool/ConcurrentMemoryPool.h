@@ -0,0 +1,261 @@
+#pragma once
+#include <cstddef> // for size_t
+#include <cstdint> // for uintptr_t
+#include <mutex>
+#include <new>
+#include <utility> // for std::forward
+#include <vector>
+
+// 线程安全的 MemoryPool
+//
+// 同一个 <T, BlockSize> 的所有分配器共用一个全局的中心仓库 (Depot_)，
+// 每个线程另有一个 thread_local 的空闲链表缓存 (Cache_):
+//   - allocate/deallocate 只操作本线程的缓存，不加锁
+//   - 缓存空了从仓库拿一整批 slot，缓存里超过两批就还一批给仓库，
+//     只有这时才加锁，锁的开销分摊到 BATCH 次分配/释放上
+//   - 在 A 线程分配、B 线程释放的对象进入 B 的缓存，B 攒够一批还给仓库，
+//     A 再从仓库拿走，生产者/消费者模式下内存也能循环使用
+//   - 线程退出时把缓存全部还给仓库
+// 仓库永远不析构，它申请的 Block 在程序退出时由系统回收:
+// 静态的容器可能比仓库先构造，如果仓库是普通的静态对象，就会先于容器析构，
+// 容器析构时再释放就会用到已经析构的 mutex 和 vector (tcmalloc 也是这么做的)
+//
+// 分配器本身没有状态，可以随意拷贝，所有实例都相等
+template <typename T, size_t BlockSize = 4096> class ConcurrentMemoryPool {
+public:
+  typedef T value_type;
+  typedef T *pointer;
+  typedef const T *const_pointer;
+  typedef T &reference;
+  typedef const T &const_reference;
+  typedef size_t size_type;
+  typedef ptrdiff_t difference_type;
+
+  template <typename U> struct rebind {
+    typedef ConcurrentMemoryPool<U, BlockSize> other;
+  };
+
+  // 每次在线程缓存和仓库之间搬运的 slot 个数
+  static const size_t BATCH = 64;
+
+  /************
+  * 构造与析构 *
+  ************/
+  ConcurrentMemoryPool() noexcept {}
+  ConcurrentMemoryPool(const ConcurrentMemoryPool &) noexcept {}
+  template <class U>
+  ConcurrentMemoryPool(const ConcurrentMemoryPool<U, BlockSize> &) noexcept {}
+
+  /*****************
+  * 获取元素所在地址 *
+  *****************/
+  inline T *address(T &element) const noexcept { return &element; }
+  inline const T *address(const T &element) const noexcept { return &element; }
+
+  /**********************
+  * 从内存池为对象分配内存 *
+  **********************/
+  // 内存池只管理单个对象，n != 1 时直接交给 operator new
+  inline T *allocate(size_t n = 1, const T *hint = nullptr) {
+    if (n != 1) {
+      return static_cast<T *>(::operator new(n * sizeof(T)));
+    }
+    Cache_ &cache = cache_();
+    if (cache.free == nullptr) {
+      cache.refill();
+    }
+    Slot_ *result = cache.free;
+    cache.free = result->next;
+    cache.count--;
+    return reinterpret_cast<T *>(result);
+  }
+
+  /**********************
+  * 从内存池为对象释放内存 *
+  **********************/
+  inline void deallocate(T *p, size_t n = 1) {
+    if (p == nullptr) {
+      return;
+    }
+    if (n != 1) {
+      ::operator delete(p);
+      return;
+    }
+    Cache_ &cache = cache_();
+    Slot_ *slot = reinterpret_cast<Slot_ *>(p);
+    slot->next = cache.free;
+    cache.free = slot;
+    if (++cache.count >= 2 * BATCH) {
+      cache.flush(BATCH);
+    }
+  }
+
+  /***************
+  * 构造与析构对象 *
+  ***************/
+  template <typename U, typename... Args>
+  inline void construct(U *p, Args &&... args) {
+    new (p) U(std::forward<Args>(args)...);
+  }
+  template <typename U> inline void destroy(U *p) { p->~U(); }
+
+  /**************
+  * new与delete *
+  **************/
+  template <typename... Args> inline T *newElement(Args &&... args) {
+    T *result = allocate();
+    construct(result, std::forward<Args>(args)...);
+    return result;
+  }
+  inline void deleteElement(T *p) {
+    if (p != nullptr) {
+      p->~T();
+      deallocate(p);
+    }
+  }
+
+  /********************
+  * 最多能容纳多少个对象 *
+  ********************/
+  inline size_t max_size() const noexcept {
+    size_t maxBlocks = -1 / BlockSize;
+    return (BlockSize - sizeof(char *)) / sizeof(Slot_) * maxBlocks;
+  }
+
+private:
+  union Slot_ {
+    T element;
+    Slot_ *next;
+  };
+
+  // 一批空闲 slot，用 next 串成链表
+  struct Batch_ {
+    Slot_ *head;
+    size_t count;
+  };
+
+  /***********
+  * 中心仓库 *
+  ***********/
+  class Depot_ {
+  public:
+    Depot_() : currentBlock_(nullptr), currentSlot_(nullptr), lastSlot_(nullptr) {}
+
+    // 优先拿别的线程还回来的一批，没有的话从 Block 中切出一批新的
+    Batch_ take() {
+      std::lock_guard<std::mutex> lg(mu_);
+      if (!batches_.empty()) {
+        Batch_ batch = batches_.back();
+        batches_.pop_back();
+        return batch;
+      }
+      if (currentSlot_ >= lastSlot_) {
+        allocateBlock_();
+      }
+      // 倒着串起来，链表头是地址最小的 slot
+      // Block 末尾剩下的不够一批时，这一批就少一些
+      Batch_ batch = {nullptr, 0};
+      size_t left = lastSlot_ - currentSlot_;
+      for (Slot_ *end = currentSlot_ + (left < BATCH ? left : BATCH);
+           end != currentSlot_;) {
+        --end;
+        end->next = batch.head;
+        batch.head = end;
+        batch.count++;
+      }
+      currentSlot_ += batch.count;
+      return batch;
+    }
+
+    void give(Batch_ batch) {
+      std::lock_guard<std::mutex> lg(mu_);
+      batches_.push_back(batch);
+    }
+
+  private:
+    std::mutex mu_;
+    std::vector<Batch_> batches_;
+    Slot_ *currentBlock_;
+    Slot_ *currentSlot_;
+    Slot_ *lastSlot_; // 当前 Block 中最后一个完整 slot 的下一个位置
+
+    // 与 MemoryPool::allocateBlock 相同，Block 的第一个字存放上一个 Block 的地址
+    void allocateBlock_() {
+      char *newBlock = reinterpret_cast<char *>(::operator new(BlockSize));
+      reinterpret_cast<Slot_ *>(newBlock)->next = currentBlock_;
+      currentBlock_ = reinterpret_cast<Slot_ *>(newBlock);
+      char *body = newBlock + sizeof(Slot_ *);
+      uintptr_t addr = reinterpret_cast<uintptr_t>(body);
+      size_t bodyPadding = (alignof(Slot_) - addr) % alignof(Slot_);
+      currentSlot_ = reinterpret_cast<Slot_ *>(body + bodyPadding);
+      lastSlot_ = currentSlot_ +
+                  (newBlock + BlockSize - reinterpret_cast<char *>(currentSlot_)) /
+                      sizeof(Slot_);
+    }
+  };
+
+  static Depot_ &depot_() {
+    static Depot_ *depot = new Depot_;
+    return *depot;
+  }
+
+  /***********
+  * 线程缓存 *
+  ***********/
+  struct Cache_ {
+    Slot_ *free;
+    size_t count;
+
+    Cache_() : free(nullptr), count(0) {}
+
+    // 线程退出时全部还给仓库
+    // 主线程的 thread_local 先于静态对象析构，静态容器析构时还会用到这个缓存，所以要清空
+    ~Cache_() {
+      if (count != 0) {
+        Batch_ batch = {free, count};
+        depot_().give(batch);
+        free = nullptr;
+        count = 0;
+      }
+    }
+
+    void refill() {
+      Batch_ batch = depot_().take();
+      free = batch.head;
+      count = batch.count;
+    }
+
+    // 把链表头部的 n 个 slot 还给仓库
+    void flush(size_t n) {
+      Batch_ batch = {free, n};
+      Slot_ *last = free;
+      for (size_t i = 1; i < n; i++) {
+        last = last->next;
+      }
+      free = last->next;
+      last->next = nullptr;
+      count -= n;
+      depot_().give(batch);
+    }
+  };
+
+  static Cache_ &cache_() {
+    static thread_local Cache_ cache;
+    return cache;
+  }
+
+  static_assert(BlockSize >= sizeof(Slot_ *) + alignof(Slot_) + sizeof(Slot_),
+                "BlockSize too small.");
+};
+
+template <typename T, typename U, size_t BlockSize>
+inline bool operator==(const ConcurrentMemoryPool<T, BlockSize> &,
+                       const ConcurrentMemoryPool<U, BlockSize> &) noexcept {
+  return true;
+}
+
+template <typename T, typename U, size_t BlockSize>
+inline bool operator!=(const ConcurrentMemoryPool<T, BlockSize> &,
+                       const ConcurrentMemoryPool<U, BlockSize> &) noexcept {
+  return false;
+}
@@ -1,20 +1,57 @@
 #pragma once
 #include <cstddef> // for size_t
 #include <cstdint> // for uintptr_t
+#include <algorithm> // for std::sort, std::upper_bound
 #include <utility> // for std::swap, std::forward
+#include <vector>
 
-template <typename T, size_t BlockSize = 4096> class MemoryPool {
+// Block 的来源，默认直接用 ::operator new
+// 其他来源 (比如 BlockSource.h 中的 MmapBlockSource) 提供同样的三个函数即可:
+//   deallocateBlock 是 trim 还回来的 Block，之后还可能再分配；
+//   releaseBlock 是内存池析构时逐个交还的 Block，之后来源本身也会析构，不能抛出异常
+struct HeapBlockSource {
+  inline void *allocateBlock(size_t size) { return ::operator new(size); }
+  inline void deallocateBlock(void *block, size_t) { ::operator delete(block); }
+  inline void releaseBlock(void *block, size_t) noexcept { ::operator delete(block); }
+};
+
+// 不做统计，所有 hook 都是空的，带统计的版本见 PoolStats.h
+// SAMPLE_SITES 为 false 时 MemoryPool 不取分配位置，单是调用 __builtin_return_address
+// 就会让编译器生成不同的代码
+struct NoPoolStats {
+protected:
+  static const bool SAMPLE_SITES = false; // 是否需要分配位置
+  inline void onAllocate(size_t, size_t, void *) noexcept {}
+  inline void onDeallocate(size_t) noexcept {}
+  inline void onBlocks(ptrdiff_t) noexcept {}
+  inline void onFreeListDrop(size_t) noexcept {}
+};
+
+// Stats 作为私有基类，NoPoolStats 是空类，不占空间
+template <typename T, size_t BlockSize = 4096, typename Source = HeapBlockSource,
+          typename Stats = NoPoolStats>
+class MemoryPool : private Stats {
 public:
-  template <typename U> struct rebind { typedef MemoryPool<U> other; };
+  // 换一个元素类型时保留 BlockSize、Block 的来源和统计策略
+  template <typename U> struct rebind {
+    typedef MemoryPool<U, BlockSize, Source, Stats> other;
+  };
   /************
   * 构造与析构 *
   ************/
   MemoryPool() noexcept;                     // 构造函数
+  explicit MemoryPool(const Source &source) noexcept; // 指定 Block 的来源
   MemoryPool(const MemoryPool &mp) noexcept; // 拷贝构造函数
   MemoryPool(MemoryPool &&mp) noexcept;      // 移动构造函数
 
   // 拷贝构造函数，但是是以另一个类型为模板
-  template <class U> MemoryPool(const MemoryPool<U> &mp) noexcept;
+  template <class U>
+  MemoryPool(const MemoryPool<U, BlockSize, Source, Stats> &mp) noexcept;
+
+  // Block 来源的配置，拷贝/rebind 出来的内存池使用同样的配置，但不共用 Block
+  inline const Source &source() const noexcept { return source_; }
+  // 统计，拷贝/rebind 出来的内存池从零开始
+  inline const Stats &stats() const noexcept { return *this; }
 
   ~MemoryPool() noexcept;
 
@@ -40,12 +77,16 @@ public:
       // 存在 freeSlots
       T *result = reinterpret_cast<T *>(freeSlots_);
       freeSlots_ = freeSlots_->next;
+      Stats::onAllocate(1, 1,
+                        Stats::SAMPLE_SITES ? __builtin_return_address(0) : nullptr);
       return result;
     } else {
       // freeSlots 还未初始化或者已经耗尽
       if (currentSlot_ >= lastSlot_) {
         allocateBlock();
       }
+      Stats::onAllocate(1, 0,
+                        Stats::SAMPLE_SITES ? __builtin_return_address(0) : nullptr);
       return reinterpret_cast<T *>(currentSlot_++);
     }
   }
@@ -60,9 +101,60 @@ public:
       // X->A->B->C
       reinterpret_cast<Slot_ *>(p)->next = freeSlots_;
       freeSlots_ = reinterpret_cast<Slot_ *>(p);
+      Stats::onDeallocate(1);
     }
   }
 
+  /***********
+  * 批量分配 *
+  ***********/
+  // 一次分配/释放 n 个 slot，指针放在 out/ptrs 数组中
+  void allocate_n(T **out, size_t n) {
+    size_t i = 0;
+    for (; i < n && freeSlots_ != nullptr; i++) {
+      out[i] = reinterpret_cast<T *>(freeSlots_);
+      freeSlots_ = freeSlots_->next;
+    }
+    Stats::onAllocate(n, i,
+                      Stats::SAMPLE_SITES ? __builtin_return_address(0) : nullptr);
+    while (i < n) {
+      if (currentSlot_ >= lastSlot_) {
+        allocateBlock();
+      }
+      for (; i < n && currentSlot_ < lastSlot_; i++) {
+        out[i] = reinterpret_cast<T *>(currentSlot_++);
+      }
+    }
+  }
+
+  // 先在这 n 个 slot 之间串好链表，最后只改一次 freeSlots_
+  void deallocate_n(T *const *ptrs, size_t n) {
+    Slot_ *head = freeSlots_;
+    size_t freed = 0;
+    for (size_t i = n; i-- > 0;) {
+      if (ptrs[i] != nullptr) {
+        reinterpret_cast<Slot_ *>(ptrs[i])->next = head;
+        head = reinterpret_cast<Slot_ *>(ptrs[i]);
+        freed++;
+      }
+    }
+    freeSlots_ = head;
+    Stats::onDeallocate(freed);
+  }
+
+  /***********
+  * 预留与回收 *
+  ***********/
+  // 预先申请足够的 Block 并把每一页都写一遍，
+  // 保证之后的 n 次 allocate 不会再向 Block 来源申请内存，也不会缺页
+  // (不计空闲链表中的 slot)
+  void reserve(size_t n);
+
+  // 把完全空闲的 Block 以及 reserve 剩下的 Block 还给 Block 来源，返回还回去的 Block 数
+  // 每个 Block 中空闲 slot 的个数在这里遍历空闲链表现算，
+  // 所以 allocate/deallocate 不需要维护任何计数；正在切分的 Block 不会被回收
+  size_t trim();
+
   /***************
   * 构造与析构对象 *
   ***************/
@@ -110,6 +202,26 @@ private:
   Slot_ *currentSlot_;
   Slot_ *lastSlot_;
   Slot_ *freeSlots_;  // 这是一个比较让人疑惑的名字，实际是指的 deallocate 之后空闲出来的 slots
+  Slot_ *spareBlocks_; // reserve 申请、还没开始切分的 Block，同样用第一个字串成链表
+  size_t spareCount_;
+  Source source_;
+
+  // 用来预先写一遍 Block 的页大小，比实际的页小也只是多写几次
+  static const size_t PREFAULT_STRIDE = 4096;
+
+  // Block 中第一个 slot 的位置，以及最后一个 slot 的下一个位置，与 allocateBlock 切分的方式一致
+  inline Slot_ *firstSlot_(char *block) const noexcept {
+    char *body = block + sizeof(Slot_ *);
+    return reinterpret_cast<Slot_ *>(body + padPointer(body, alignof(Slot_)));
+  }
+  static inline Slot_ *endSlot_(char *block) noexcept {
+    return reinterpret_cast<Slot_ *>(block + BlockSize - sizeof(Slot_) + 1);
+  }
+  inline size_t slotsInBlock_(char *block) const noexcept {
+    char *first = reinterpret_cast<char *>(firstSlot_(block));
+    char *last = reinterpret_cast<char *>(endSlot_(block));
+    return (last - first + sizeof(Slot_) - 1) / sizeof(Slot_);
+  }
 
   /*******
   * 对齐 *
@@ -127,53 +239,73 @@ private:
   static_assert(BlockSize >= 2 * sizeof(Slot_), "BlockSize too small.");
 };
 
-template <typename T, size_t BlockSize>
-MemoryPool<T, BlockSize>::MemoryPool() noexcept {
+template <typename T, size_t BlockSize, typename Source, typename Stats>
+MemoryPool<T, BlockSize, Source, Stats>::MemoryPool() noexcept
+    : MemoryPool(Source()) {}
+
+template <typename T, size_t BlockSize, typename Source, typename Stats>
+MemoryPool<T, BlockSize, Source, Stats>::MemoryPool(const Source &source) noexcept
+    : source_(source) {
   currentBlock_ = nullptr;
   currentSlot_ = nullptr;
   lastSlot_ = nullptr;
   freeSlots_ = nullptr;
+  spareBlocks_ = nullptr;
+  spareCount_ = 0;
 }
 
-template <typename T, size_t BlockSize>
-MemoryPool<T, BlockSize>::MemoryPool(const MemoryPool &mp) noexcept
-    : MemoryPool() {}
+template <typename T, size_t BlockSize, typename Source, typename Stats>
+MemoryPool<T, BlockSize, Source, Stats>::MemoryPool(const MemoryPool &mp) noexcept
+    : MemoryPool(mp.source_) {}
 
-template <typename T, size_t BlockSize>
-MemoryPool<T, BlockSize>::MemoryPool(MemoryPool &&mp) noexcept {
+template <typename T, size_t BlockSize, typename Source, typename Stats>
+MemoryPool<T, BlockSize, Source, Stats>::MemoryPool(MemoryPool &&mp) noexcept
+    : Stats(std::move(static_cast<Stats &>(mp))), source_(std::move(mp.source_)) {
   currentBlock_ = mp.currentBlock_;
   mp.currentBlock_ = nullptr;
   currentSlot_ = mp.currentSlot_;
   lastSlot_ = mp.lastSlot_;
   freeSlots_ = mp.freeSlots_;
+  spareBlocks_ = mp.spareBlocks_;
+  mp.spareBlocks_ = nullptr;
+  spareCount_ = mp.spareCount_;
+  mp.spareCount_ = 0;
 }
 
-template <typename T, size_t BlockSize>
+template <typename T, size_t BlockSize, typename Source, typename Stats>
 template <typename U>
-MemoryPool<T, BlockSize>::MemoryPool(const MemoryPool<U> &mp) noexcept
-    : MemoryPool() {}
+MemoryPool<T, BlockSize, Source, Stats>::MemoryPool(
+    const MemoryPool<U, BlockSize, Source, Stats> &mp) noexcept
+    : MemoryPool(mp.source()) {}
 
-template <typename T, size_t BlockSize>
-MemoryPool<T, BlockSize>::~MemoryPool() noexcept {
-  Slot_ *cur = currentBlock_;
-  while (cur != nullptr) {
-    Slot_ *nextBlock = cur->next;
-    ::operator delete(reinterpret_cast<void *>(cur));
-    cur = nextBlock;
+template <typename T, size_t BlockSize, typename Source, typename Stats>
+MemoryPool<T, BlockSize, Source, Stats>::~MemoryPool() noexcept {
+  Slot_ *lists[] = {currentBlock_, spareBlocks_};
+  for (Slot_ *cur : lists) {
+    while (cur != nullptr) {
+      Slot_ *nextBlock = cur->next;
+      source_.releaseBlock(reinterpret_cast<void *>(cur), BlockSize);
+      cur = nextBlock;
+    }
   }
 }
 
 /**********
 * 移动赋值 *
 **********/
-template <typename T, size_t BlockSize>
-MemoryPool<T, BlockSize> &MemoryPool<T, BlockSize>::
+// 和 mp 交换全部状态，原来的 Block 随 mp 析构释放
+template <typename T, size_t BlockSize, typename Source, typename Stats>
+MemoryPool<T, BlockSize, Source, Stats> &MemoryPool<T, BlockSize, Source, Stats>::
 operator=(MemoryPool &&mp) noexcept {
   if (this != &mp) {
+    std::swap(currentBlock_, mp.currentBlock_);
     std::swap(currentSlot_, mp.currentSlot_);
-    currentSlot_ = mp.currentSlot_;
-    lastSlot_ = mp.lastSlot_;
-    freeSlots_ = mp.freeSlots_;
+    std::swap(lastSlot_, mp.lastSlot_);
+    std::swap(freeSlots_, mp.freeSlots_);
+    std::swap(spareBlocks_, mp.spareBlocks_);
+    std::swap(spareCount_, mp.spareCount_);
+    std::swap(source_, mp.source_);
+    std::swap(static_cast<Stats &>(*this), static_cast<Stats &>(mp));
   }
   return *this;
 }
@@ -181,20 +313,134 @@ operator=(MemoryPool &&mp) noexcept {
 /*****************
 * 为内存池分配内存 *
 *****************/
-template <typename T, size_t BlockSize>
-void MemoryPool<T, BlockSize>::allocateBlock() {
+template <typename T, size_t BlockSize, typename Source, typename Stats>
+void MemoryPool<T, BlockSize, Source, Stats>::allocateBlock() {
   // 头插链表
   // A->B->C 插入 X
   // X->A->B->C
-  char *newBlock = reinterpret_cast<char *>(::operator new(BlockSize));
+  // 有 reserve 留下的 Block 就先用它
+  char *newBlock;
+  if (spareBlocks_ != nullptr) {
+    newBlock = reinterpret_cast<char *>(spareBlocks_);
+    spareBlocks_ = spareBlocks_->next;
+    spareCount_--;
+  } else {
+    newBlock = reinterpret_cast<char *>(source_.allocateBlock(BlockSize));
+    Stats::onBlocks(1);
+  }
   reinterpret_cast<Slot_ *>(newBlock)->next = currentBlock_;
   currentBlock_ = reinterpret_cast<Slot_ *>(newBlock);
   // 这里需要作一个内存对齐，因为第一个区域存放的是指向上一个 Block 的指针，而不是 Slot
   // 而之后的都是Slot
-  char *body = newBlock + sizeof(Slot_ *);
-  size_t bodyPadding = padPointer(body, alignof(Slot_));
-  currentSlot_ = reinterpret_cast<Slot_ *>(body + bodyPadding);
+  currentSlot_ = firstSlot_(newBlock);
+  lastSlot_ = endSlot_(newBlock);
+}
+
+/***********
+* 预留与回收 *
+***********/
+template <typename T, size_t BlockSize, typename Source, typename Stats>
+void MemoryPool<T, BlockSize, Source, Stats>::reserve(size_t n) {
+  size_t left = currentSlot_ < lastSlot_
+                    ? (reinterpret_cast<char *>(lastSlot_) -
+                       reinterpret_cast<char *>(currentSlot_) + sizeof(Slot_) - 1) /
+                          sizeof(Slot_)
+                    : 0;
+  // 每个 Block 至少能放下的 slot 数 (不同地址的对齐填充可能不同)
+  size_t perBlock = (BlockSize - sizeof(Slot_ *) - alignof(Slot_) + 1) / sizeof(Slot_);
+  size_t have = left + spareCount_ * perBlock;
+  while (have < n) {
+    char *block = reinterpret_cast<char *>(source_.allocateBlock(BlockSize));
+    for (size_t off = 0; off < BlockSize; off += PREFAULT_STRIDE) {
+      static_cast<volatile char *>(block)[off] = 0;
+    }
+    Stats::onBlocks(1);
+    reinterpret_cast<Slot_ *>(block)->next = spareBlocks_;
+    spareBlocks_ = reinterpret_cast<Slot_ *>(block);
+    spareCount_++;
+    have += perBlock;
+  }
+}
 
-  lastSlot_ =
-      reinterpret_cast<Slot_ *>(newBlock + BlockSize - sizeof(Slot_) + 1);
+template <typename T, size_t BlockSize, typename Source, typename Stats>
+size_t MemoryPool<T, BlockSize, Source, Stats>::trim() {
+  size_t released = 0;
+  while (spareBlocks_ != nullptr) {
+    Slot_ *nextBlock = spareBlocks_->next;
+    source_.deallocateBlock(reinterpret_cast<void *>(spareBlocks_), BlockSize);
+    spareBlocks_ = nextBlock;
+    released++;
+  }
+  spareCount_ = 0;
+  Stats::onBlocks(-static_cast<ptrdiff_t>(released));
+  if (currentBlock_ == nullptr || freeSlots_ == nullptr) {
+    return released;
+  }
+
+  // 按地址排好序的 Block (不含正在切分的那个)，以及每个 Block 中空闲 slot 的个数
+  std::vector<char *> blocks;
+  for (Slot_ *b = currentBlock_->next; b != nullptr; b = b->next) {
+    blocks.push_back(reinterpret_cast<char *>(b));
+  }
+  if (blocks.empty()) {
+    return released;
+  }
+  std::sort(blocks.begin(), blocks.end());
+  std::vector<size_t> freeCount(blocks.size(), 0);
+
+  // slot 所在 Block 的下标，不在这些 Block 中时返回 blocks.size()
+  auto blockOf = [&](Slot_ *slot) -> size_t {
+    char *addr = reinterpret_cast<char *>(slot);
+    auto it = std::upper_bound(blocks.begin(), blocks.end(), addr);
+    if (it == blocks.begin() || addr >= *(it - 1) + BlockSize) {
+      return blocks.size();
+    }
+    return it - 1 - blocks.begin();
+  };
+
+  for (Slot_ *slot = freeSlots_; slot != nullptr; slot = slot->next) {
+    size_t i = blockOf(slot);
+    if (i != blocks.size()) {
+      freeCount[i]++;
+    }
+  }
+  std::vector<bool> empty(blocks.size());
+  bool any = false;
+  for (size_t i = 0; i < blocks.size(); i++) {
+    empty[i] = freeCount[i] == slotsInBlock_(blocks[i]);
+    any = any || empty[i];
+  }
+  if (!any) {
+    return released;
+  }
+
+  // 从空闲链表中去掉这些 Block 中的 slot，保持原来的顺序
+  Slot_ **link = &freeSlots_;
+  size_t dropped = 0;
+  while (*link != nullptr) {
+    size_t i = blockOf(*link);
+    if (i != blocks.size() && empty[i]) {
+      *link = (*link)->next;
+      dropped++;
+    } else {
+      link = &(*link)->next;
+    }
+  }
+  Stats::onFreeListDrop(dropped);
+  // 从 Block 链表中摘掉并还回去
+  size_t spare = released;
+  Slot_ **blockLink = &currentBlock_->next;
+  while (*blockLink != nullptr) {
+    Slot_ *block = *blockLink;
+    size_t i = blockOf(block);
+    if (empty[i]) {
+      *blockLink = block->next;
+      source_.deallocateBlock(reinterpret_cast<void *>(block), BlockSize);
+      released++;
+    } else {
+      blockLink = &block->next;
+    }
+  }
+  Stats::onBlocks(-static_cast<ptrdiff_t>(released - spare));
+  return released;
 }
@@ -0,0 +1,80 @@
+#pragma once
+// 需要 -std=c++17
+#include <cstddef> // for size_t
+#include <memory_resource>
+#include <type_traits>
+
+#include "Arena.h"
+#include "MemoryPool.h"
+
+// 把 Arena 和 MemoryPool 包装成 std::pmr::memory_resource，
+// std::pmr::vector/string/unordered_map 等容器可以直接使用，
+// 不用把每个类型都写成以分配器为模板参数的形式
+
+// deallocate 什么都不做，内存在 arena.reset() 时统一回收
+class ArenaResource : public std::pmr::memory_resource {
+public:
+  explicit ArenaResource(Arena &arena) noexcept : arena_(arena) {}
+
+  inline Arena &arena() noexcept { return arena_; }
+
+private:
+  Arena &arena_;
+
+  void *do_allocate(size_t bytes, size_t align) override {
+    return arena_.allocate(bytes, align);
+  }
+
+  void do_deallocate(void *, size_t, size_t) override {}
+
+  bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override {
+    return this == &other;
+  }
+};
+
+// 固定大小 slot 的池: 不超过 SlotSize 字节的请求从 MemoryPool 分配，
+// 其他请求交给 upstream。适合 list/map/set 这类节点大小固定的容器
+// 和 MemoryPool 一样不是线程安全的
+template <size_t SlotSize, size_t BlockSize = 4096>
+class PoolResource : public std::pmr::memory_resource {
+public:
+  explicit PoolResource(
+      std::pmr::memory_resource *upstream = std::pmr::get_default_resource()) noexcept
+      : upstream_(upstream) {}
+
+  PoolResource(const PoolResource &) = delete;
+  PoolResource &operator=(const PoolResource &) = delete;
+
+  inline std::pmr::memory_resource *upstream_resource() const noexcept {
+    return upstream_;
+  }
+
+private:
+  typedef typename std::aligned_storage<SlotSize>::type Slot_;
+
+  MemoryPool<Slot_, BlockSize> pool_;
+  std::pmr::memory_resource *upstream_;
+
+  static inline bool fits_(size_t bytes, size_t align) noexcept {
+    return bytes <= sizeof(Slot_) && align <= alignof(Slot_);
+  }
+
+  void *do_allocate(size_t bytes, size_t align) override {
+    if (fits_(bytes, align)) {
+      return pool_.allocate();
+    }
+    return upstream_->allocate(bytes, align);
+  }
+
+  void do_deallocate(void *p, size_t bytes, size_t align) override {
+    if (fits_(bytes, align)) {
+      pool_.deallocate(static_cast<Slot_ *>(p));
+    } else {
+      upstream_->deallocate(p, bytes, align);
+    }
+  }
+
+  bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override {
+    return this == &other;
+  }
+};
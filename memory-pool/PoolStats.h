@@ -0,0 +1,206 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstddef> // for size_t, ptrdiff_t
+#include <cstdint> // for uint64_t
+
+// MemoryPool 的统计策略 (第四个模板参数):
+//   MemoryPool<T, BlockSize, Source, PoolStats<>> pool;
+//   PoolSnapshot s = pool.stats().snapshot();
+//
+// 默认的 NoPoolStats (见 MemoryPool.h) 是空类，所有 hook 都是空的 inline 函数，
+// MemoryPool 私有继承它，空基类不占空间，编译出来和没有统计时完全一样。
+//
+// 内存池只被一个线程使用，计数器只有这一个线程写，所以不需要原子的加法；
+// 用 relaxed 的 atomic 读写只是为了让监控线程可以随时 snapshot() 而不构成数据竞争，
+// 在 x86 上就是普通的 mov
+
+// 某一时刻的统计。各个字段是分别读出来的，被统计的线程还在运行时它们之间不严格一致，
+// live 等派生的值只是近似值
+struct PoolSnapshot {
+  size_t live;          // 当前存活的对象个数 (近似)
+  size_t highWater;     // 存活对象个数的最大值
+  size_t blocks;        // 当前持有的 Block 个数 (包括 reserve 的备用 Block)
+  size_t freeList;      // 空闲链表长度
+  size_t allocations;   // 累计分配次数
+  size_t deallocations; // 累计释放次数
+  double seconds;       // 统计开始到现在的秒数
+};
+
+// 两次 snapshot 之间每秒的分配次数
+inline double allocationRate(const PoolSnapshot &before, const PoolSnapshot &after) {
+  double secs = after.seconds - before.seconds;
+  return secs > 0 ? (after.allocations - before.allocations) / secs : 0;
+}
+
+// 采样到的分配位置 (调用 allocate 的函数的返回地址) 以及被采样到的次数
+struct PoolSite {
+  void *address;
+  size_t count;
+};
+
+// SampleEvery 不为 0 时平均每 SampleEvery 次分配记录一次分配位置，最多记录 MAX_SITES 个不同的位置
+// 采样间隔在 [SampleEvery / 2, SampleEvery * 3 / 2) 之间随机，避免和程序本身周期性的分配模式对齐，
+// 只采到其中一个位置
+template <size_t SampleEvery = 0> class PoolStats {
+public:
+  static const size_t MAX_SITES = 16;
+  static const bool SAMPLE_SITES = SampleEvery != 0;
+
+  PoolStats() noexcept : start_(std::chrono::steady_clock::now()) { reset_(); }
+
+  // 内存池移动时统计跟着走
+  PoolStats(PoolStats &&other) noexcept : start_(other.start_) { copy_(other); }
+  PoolStats &operator=(PoolStats &&other) noexcept {
+    start_ = other.start_;
+    copy_(other);
+    return *this;
+  }
+
+  PoolSnapshot snapshot() const noexcept {
+    PoolSnapshot s;
+    // 先读释放次数再读分配次数，两次读之间的分配只会让 live 偏大；
+    // relaxed 不保证不同变量之间的顺序，所以还要在 0 处截断，不能减出一个巨大的 size_t
+    s.deallocations = load_(deallocations_);
+    s.allocations = load_(allocations_);
+    s.live = s.allocations > s.deallocations ? s.allocations - s.deallocations : 0;
+    s.highWater = load_(highWater_);
+    s.blocks = load_(blocks_);
+    s.freeList = load_(freeList_);
+    std::chrono::duration<double> diff = std::chrono::steady_clock::now() - start_;
+    s.seconds = diff.count();
+    return s;
+  }
+
+  // 采样到的分配位置，返回个数；按第一次采样到的先后排列
+  size_t sites(PoolSite *out, size_t max) const noexcept {
+    size_t n = 0;
+    for (size_t i = 0; i < MAX_SITES && n < max; i++) {
+      void *addr = sites_[i].address.load(std::memory_order_relaxed);
+      if (addr != nullptr) {
+        out[n].address = addr;
+        out[n].count = load_(sites_[i].count);
+        n++;
+      }
+    }
+    return n;
+  }
+
+protected:
+  /********************
+  * MemoryPool 调用的 hook *
+  ********************/
+  // 分配了 n 个，其中 fromFreeList 个来自空闲链表
+  inline void onAllocate(size_t n, size_t fromFreeList, void *site) noexcept {
+    size_t allocations = load_(allocations_) + n;
+    store_(allocations_, allocations);
+    store_(freeList_, load_(freeList_) - fromFreeList);
+    size_t live = allocations - load_(deallocations_);
+    if (live > load_(highWater_)) {
+      store_(highWater_, live);
+    }
+    if (SAMPLE_SITES) {
+      sample_(site);
+    }
+  }
+
+  inline void onDeallocate(size_t n) noexcept {
+    store_(deallocations_, load_(deallocations_) + n);
+    store_(freeList_, load_(freeList_) + n);
+  }
+
+  inline void onBlocks(ptrdiff_t delta) noexcept {
+    store_(blocks_, load_(blocks_) + delta);
+  }
+
+  // trim 从空闲链表中去掉了 n 个 slot
+  inline void onFreeListDrop(size_t n) noexcept {
+    store_(freeList_, load_(freeList_) - n);
+  }
+
+private:
+  struct Site_ {
+    std::atomic<void *> address;
+    std::atomic<size_t> count;
+  };
+
+  std::atomic<size_t> allocations_;
+  std::atomic<size_t> deallocations_;
+  std::atomic<size_t> highWater_;
+  std::atomic<size_t> blocks_;
+  std::atomic<size_t> freeList_;
+  size_t untilSample_; // 距离下一次采样还有几次分配，只有分配的线程访问
+  uint64_t random_;    // xorshift 的状态
+  Site_ sites_[MAX_SITES];
+  std::chrono::steady_clock::time_point start_;
+
+  static inline size_t load_(const std::atomic<size_t> &a) noexcept {
+    return a.load(std::memory_order_relaxed);
+  }
+  static inline void store_(std::atomic<size_t> &a, size_t v) noexcept {
+    a.store(v, std::memory_order_relaxed);
+  }
+
+  void reset_() noexcept {
+    store_(allocations_, 0);
+    store_(deallocations_, 0);
+    store_(highWater_, 0);
+    store_(blocks_, 0);
+    store_(freeList_, 0);
+    random_ = 0x9E3779B97F4A7C15ULL;
+    untilSample_ = nextInterval_();
+    for (Site_ &site : sites_) {
+      site.address.store(nullptr, std::memory_order_relaxed);
+      store_(site.count, 0);
+    }
+  }
+
+  void copy_(const PoolStats &other) noexcept {
+    store_(allocations_, load_(other.allocations_));
+    store_(deallocations_, load_(other.deallocations_));
+    store_(highWater_, load_(other.highWater_));
+    store_(blocks_, load_(other.blocks_));
+    store_(freeList_, load_(other.freeList_));
+    untilSample_ = other.untilSample_;
+    random_ = other.random_;
+    for (size_t i = 0; i < MAX_SITES; i++) {
+      sites_[i].address.store(other.sites_[i].address.load(std::memory_order_relaxed),
+                              std::memory_order_relaxed);
+      store_(sites_[i].count, load_(other.sites_[i].count));
+    }
+  }
+
+  inline void sample_(void *site) noexcept {
+    if (--untilSample_ != 0) {
+      return;
+    }
+    untilSample_ = nextInterval_();
+    recordSite_(site);
+  }
+
+  size_t nextInterval_() noexcept {
+    if (SampleEvery < 2) {
+      return 1;
+    }
+    random_ ^= random_ << 13;
+    random_ ^= random_ >> 7;
+    random_ ^= random_ << 17;
+    return SampleEvery / 2 + random_ % SampleEvery;
+  }
+
+  // 表满了之后新的位置不再记录
+  void recordSite_(void *site) noexcept {
+    for (Site_ &s : sites_) {
+      void *addr = s.address.load(std::memory_order_relaxed);
+      if (addr == site) {
+        store_(s.count, load_(s.count) + 1);
+        return;
+      }
+      if (addr == nullptr) {
+        store_(s.count, 1);
+        s.address.store(site, std::memory_order_relaxed);
+        return;
+      }
+    }
+  }
+};
@@ -0,0 +1,244 @@
+#pragma once
+#include <cstddef> // for size_t
+#include <mutex>
+#include <new>
+#include <utility> // for std::forward
+#include <vector>
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "ConcurrentMemoryPool.h"
+
+// 按大小分级的分配器，可以用于 vector/string/unordered_map/deque 等任何标准容器
+//
+// MemoryPool 只能一次分配一个 T，适合链表/树这类节点容器；
+// 这里把 n * sizeof(T) 字节的请求按大小分流:
+//   - 不超过 MAX_SMALL 字节: 向上取整到某个 size class，
+//     每个 size class 是一个 ConcurrentMemoryPool (slab)，带线程缓存
+//   - 更大的请求交给 PageHeap，按页分配，释放的 span 留一部分复用
+// 标准分配器的 deallocate 会带上 n，所以不需要在内存前面记录大小
+namespace size_class {
+
+const size_t ALIGN = 16;          // 所有 size class 都按 16 字节对齐 (alignof(max_align_t))
+const size_t MAX_SMALL = 1024;    // 超过这个大小的请求按页分配
+const size_t SLAB_BLOCK = 1 << 16; // 每个 slab 每次向系统申请的 Block 大小
+
+// 一个 size class 的 slot
+template <size_t Size> struct Chunk {
+  alignas(ALIGN) char data[Size];
+};
+
+template <size_t Size> void *slabAlloc() {
+  return ConcurrentMemoryPool<Chunk<Size>, SLAB_BLOCK>().allocate(1);
+}
+
+template <size_t Size> void slabFree(void *p) {
+  ConcurrentMemoryPool<Chunk<Size>, SLAB_BLOCK>().deallocate(
+      static_cast<Chunk<Size> *>(p), 1);
+}
+
+struct SizeClass {
+  size_t size;
+  void *(*alloc)();
+  void (*free)(void *);
+};
+
+// 128 字节以内间隔 16，之后每级大约 1.5 倍，浪费不超过 1/3
+static const SizeClass CLASSES[] = {
+    {16, &slabAlloc<16>, &slabFree<16>},       {32, &slabAlloc<32>, &slabFree<32>},
+    {48, &slabAlloc<48>, &slabFree<48>},       {64, &slabAlloc<64>, &slabFree<64>},
+    {80, &slabAlloc<80>, &slabFree<80>},       {96, &slabAlloc<96>, &slabFree<96>},
+    {112, &slabAlloc<112>, &slabFree<112>},    {128, &slabAlloc<128>, &slabFree<128>},
+    {192, &slabAlloc<192>, &slabFree<192>},    {256, &slabAlloc<256>, &slabFree<256>},
+    {384, &slabAlloc<384>, &slabFree<384>},    {512, &slabAlloc<512>, &slabFree<512>},
+    {768, &slabAlloc<768>, &slabFree<768>},    {1024, &slabAlloc<1024>, &slabFree<1024>},
+};
+
+// bytes 所在 size class 的下标，bytes 不超过 MAX_SMALL
+inline size_t classIndex(size_t bytes) {
+  if (bytes <= 128) {
+    return bytes == 0 ? 0 : (bytes - 1) / 16;
+  }
+  size_t i = 8;
+  while (CLASSES[i].size < bytes) {
+    i++;
+  }
+  return i;
+}
+
+/***********
+* 页级后端 *
+***********/
+// 以页为单位的 span，释放后不马上还给系统:
+//   - 不超过 MAX_CACHED_PAGES 页的按页数放进对应的空闲列表，每种最多 MAX_CACHED_SPANS 个
+//   - 更大的放进一个列表，按页数精确匹配复用 (容器扩容的大小序列是固定的，
+//     比如 unordered_map 的桶数组)，总量超过 MAX_CACHED_BYTES 时先还最早放进来的
+// 否则每次扩容都是一次 mmap + munmap，新映射的页还要重新缺页
+class PageHeap {
+public:
+  static const size_t MAX_CACHED_PAGES = 64;
+  static const size_t MAX_CACHED_SPANS = 16;
+  static const size_t MAX_CACHED_BYTES = 64 << 20;
+
+  // 和 ConcurrentMemoryPool 的仓库一样永远不析构，静态容器析构时还可以释放到这里
+  static PageHeap &instance() {
+    static PageHeap *heap = new PageHeap;
+    return *heap;
+  }
+
+  inline size_t pageSize() const { return pageSize_; }
+
+  // 返回的内存按页对齐；0 字节也占一页
+  void *allocate(size_t bytes) {
+    size_t pages = pages_(bytes);
+    {
+      std::lock_guard<std::mutex> lg(mu_);
+      if (pages <= MAX_CACHED_PAGES) {
+        std::vector<void *> &spans = free_[pages];
+        if (!spans.empty()) {
+          void *p = spans.back();
+          spans.pop_back();
+          return p;
+        }
+      } else {
+        for (size_t i = large_.size(); i-- > 0;) {
+          if (large_[i].pages == pages) {
+            void *p = large_[i].addr;
+            large_.erase(large_.begin() + i);
+            largeBytes_ -= pages * pageSize_;
+            return p;
+          }
+        }
+      }
+    }
+    void *p = mmap(nullptr, pages * pageSize_, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED) {
+      throw std::bad_alloc();
+    }
+    return p;
+  }
+
+  void deallocate(void *p, size_t bytes) {
+    size_t pages = pages_(bytes);
+    std::vector<Span_> evicted;
+    {
+      std::lock_guard<std::mutex> lg(mu_);
+      if (pages <= MAX_CACHED_PAGES) {
+        std::vector<void *> &spans = free_[pages];
+        if (spans.size() < MAX_CACHED_SPANS) {
+          spans.push_back(p);
+          return;
+        }
+      } else if (pages * pageSize_ <= MAX_CACHED_BYTES) {
+        Span_ span = {p, pages};
+        large_.push_back(span);
+        largeBytes_ += pages * pageSize_;
+        size_t n = 0;
+        while (largeBytes_ > MAX_CACHED_BYTES) {
+          largeBytes_ -= large_[n].pages * pageSize_;
+          evicted.push_back(large_[n++]);
+        }
+        large_.erase(large_.begin(), large_.begin() + n);
+        p = nullptr;
+      }
+    }
+    // munmap 不用持有锁
+    for (const Span_ &span : evicted) {
+      munmap(span.addr, span.pages * pageSize_);
+    }
+    if (p != nullptr) {
+      munmap(p, pages * pageSize_);
+    }
+  }
+
+private:
+  struct Span_ {
+    void *addr;
+    size_t pages;
+  };
+
+  PageHeap() : pageSize_(sysconf(_SC_PAGESIZE)), largeBytes_(0) {}
+
+  inline size_t pages_(size_t bytes) const {
+    return bytes == 0 ? 1 : (bytes + pageSize_ - 1) / pageSize_;
+  }
+
+  std::mutex mu_;
+  size_t pageSize_;
+  std::vector<void *> free_[MAX_CACHED_PAGES + 1]; // 下标为页数
+  std::vector<Span_> large_;                       // 按放入的先后顺序
+  size_t largeBytes_;
+};
+
+// 对齐要求超过一页的请求不支持，抛出 bad_alloc 而不是返回没有对齐的内存
+inline void *allocate(size_t bytes, size_t align) {
+  if (bytes <= MAX_SMALL && align <= ALIGN) {
+    return CLASSES[classIndex(bytes)].alloc();
+  }
+  PageHeap &heap = PageHeap::instance();
+  if (align > heap.pageSize()) {
+    throw std::bad_alloc();
+  }
+  return heap.allocate(bytes);
+}
+
+inline void deallocate(void *p, size_t bytes, size_t align) {
+  if (bytes <= MAX_SMALL && align <= ALIGN) {
+    CLASSES[classIndex(bytes)].free(p);
+  } else {
+    PageHeap::instance().deallocate(p, bytes);
+  }
+}
+
+} // namespace size_class
+
+template <typename T> class SizeClassAllocator {
+public:
+  typedef T value_type;
+  typedef T *pointer;
+  typedef const T *const_pointer;
+  typedef T &reference;
+  typedef const T &const_reference;
+  typedef size_t size_type;
+  typedef ptrdiff_t difference_type;
+
+  template <typename U> struct rebind { typedef SizeClassAllocator<U> other; };
+
+  SizeClassAllocator() noexcept {}
+  template <class U> SizeClassAllocator(const SizeClassAllocator<U> &) noexcept {}
+
+  inline T *allocate(size_t n, const T *hint = nullptr) {
+    if (n > max_size()) {
+      throw std::bad_alloc();
+    }
+    return static_cast<T *>(size_class::allocate(n * sizeof(T), alignof(T)));
+  }
+
+  inline void deallocate(T *p, size_t n) {
+    if (p != nullptr) {
+      size_class::deallocate(p, n * sizeof(T), alignof(T));
+    }
+  }
+
+  template <typename U, typename... Args>
+  inline void construct(U *p, Args &&... args) {
+    new (p) U(std::forward<Args>(args)...);
+  }
+  template <typename U> inline void destroy(U *p) { p->~U(); }
+
+  inline size_t max_size() const noexcept { return size_t(-1) / sizeof(T); }
+};
+
+template <typename T, typename U>
+inline bool operator==(const SizeClassAllocator<T> &,
+                       const SizeClassAllocator<U> &) noexcept {
+  return true;
+}
+
+template <typename T, typename U>
+inline bool operator!=(const SizeClassAllocator<T> &,
+                       const SizeClassAllocator<U> &) noexcept {
+  return false;
+}
@@ -0,0 +1,95 @@
+/*-
+ * 指针追逐: 在内存池分配的节点上按随机顺序走链表，每一步都依赖上一步读出的指针，
+ * 主要开销是 cache miss 和 TLB miss，对比不同的 Block 来源
+ *
+ *   std::allocator                每个节点单独 new
+ *   MemoryPool (heap)             4 KB 的 Block 逐个 ::operator new
+ *   MemoryPool (mmap, 4 KB pages) 大块 mmap 切成 Block
+ *   MemoryPool (mmap, THP)        region 按 2 MB 对齐并 madvise(MADV_HUGEPAGE)
+ *   MemoryPool (mmap, hugetlb)    MAP_HUGETLB，没有预留大页时退回 THP
+ *
+ * 编译: make mem_pool_chase_test
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "BlockSource.h"
+#include "MemoryPool.h"
+
+#define NODES (1 << 21)
+#define HOPS (1 << 24)
+
+struct Node {
+  Node *next;
+  long payload[3];
+};
+
+// 用 alloc 分配 NODES 个节点，按随机顺序串成一个环，返回每一步的平均耗时 (ns)
+template <typename Alloc> double chase(Alloc &alloc) {
+  std::vector<Node *> nodes(NODES);
+  for (size_t i = 0; i < nodes.size(); i++) {
+    nodes[i] = alloc.allocate(1);
+    nodes[i]->payload[0] = i;
+  }
+  std::vector<Node *> order(nodes);
+  std::shuffle(order.begin(), order.end(), std::mt19937_64(42));
+  for (size_t i = 0; i < order.size(); i++) {
+    order[i]->next = order[(i + 1) % order.size()];
+  }
+
+  Node *p = order[0];
+  long sum = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < HOPS; i++) {
+    sum += p->payload[0];
+    p = p->next;
+  }
+  std::chrono::duration<double, std::nano> diff =
+      std::chrono::steady_clock::now() - start;
+
+  for (Node *node : nodes) {
+    alloc.deallocate(node, 1);
+  }
+  return sum == -1 ? 0 : diff.count() / HOPS;
+}
+
+const char *hugeName(HugePages huge) {
+  switch (huge) {
+  case HugePages::None:
+    return "4 KB pages";
+  case HugePages::Transparent:
+    return "THP";
+  default:
+    return "hugetlb";
+  }
+}
+
+void chaseMmap(HugePages huge) {
+  MmapOptions options;
+  options.huge = huge;
+  MemoryPool<Node, 4096, MmapBlockSource> pool((MmapBlockSource(options)));
+  double ns = chase(pool);
+  char name[64];
+  snprintf(name, sizeof(name), "MemoryPool (mmap, %s)", hugeName(huge));
+  printf("%-32s %6.1f ns/hop", name, ns);
+  if (pool.source().hugePages() != huge) {
+    printf("  (fell back to %s)", hugeName(pool.source().hugePages()));
+  }
+  printf("\n");
+}
+
+int main() {
+  printf("%d nodes of %zu bytes, %d hops\n", NODES, sizeof(Node), HOPS);
+  std::allocator<Node> std_alloc;
+  printf("%-32s %6.1f ns/hop\n", "std::allocator", chase(std_alloc));
+  MemoryPool<Node> heap_pool;
+  printf("%-32s %6.1f ns/hop\n", "MemoryPool (heap)", chase(heap_pool));
+  chaseMmap(HugePages::None);
+  chaseMmap(HugePages::Transparent);
+  chaseMmap(HugePages::Explicit);
+  return 0;
+}
@@ -0,0 +1,106 @@
+/*-
+ * 对比 std::allocator 和 SizeClassAllocator 在常用容器上的耗时
+ *
+ *   vector         大量小 vector 不断 push_back，容量按倍数增长，每次都是 n > 1 的分配
+ *   string         拼接出长短不一的字符串
+ *   unordered_map  插入再删除，节点和桶数组都走分配器
+ *   deque          两端 push/pop，按固定大小的块分配
+ *
+ * 编译: make mem_pool_container_test
+ */
+
+#include <cassert>
+#include <chrono>
+#include <cstdio>
+#include <deque>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "SizeClassAllocator.h"
+
+#define REPS 20
+
+template <typename Func> double timeIt(Func func) {
+  auto start = std::chrono::steady_clock::now();
+  for (int j = 0; j < REPS; j++) {
+    func();
+  }
+  std::chrono::duration<double> diff = std::chrono::steady_clock::now() - start;
+  return diff.count();
+}
+
+template <template <typename> class Alloc> double vectorBench() {
+  typedef std::vector<int, Alloc<int> > Vec;
+  return timeIt([] {
+    std::vector<Vec, Alloc<Vec> > vecs(10000);
+    for (int i = 0; i < 100; i++) {
+      for (size_t k = 0; k < vecs.size(); k++) {
+        vecs[k].push_back(i);
+      }
+    }
+    size_t sum = 0;
+    for (const Vec &v : vecs) {
+      sum += v.size();
+    }
+    assert(sum == 100 * vecs.size());
+  });
+}
+
+template <template <typename> class Alloc> double stringBench() {
+  typedef std::basic_string<char, std::char_traits<char>, Alloc<char> > Str;
+  return timeIt([] {
+    std::vector<Str, Alloc<Str> > strs;
+    for (int i = 0; i < 100000; i++) {
+      Str s("prefix-");
+      for (int k = 0; k < i % 64; k++) {
+        s += "abcd";
+      }
+      strs.push_back(s);
+    }
+    assert(strs.size() == 100000);
+  });
+}
+
+template <template <typename> class Alloc> double mapBench() {
+  typedef std::unordered_map<int, int, std::hash<int>, std::equal_to<int>,
+                             Alloc<std::pair<const int, int> > > Map;
+  return timeIt([] {
+    Map m;
+    for (int i = 0; i < 200000; i++) {
+      m[i] = i;
+    }
+    for (int i = 0; i < 200000; i += 2) {
+      m.erase(i);
+    }
+    assert(m.size() == 100000);
+  });
+}
+
+template <template <typename> class Alloc> double dequeBench() {
+  return timeIt([] {
+    std::deque<int, Alloc<int> > d;
+    for (int i = 0; i < 1000000; i++) {
+      d.push_back(i);
+      if (i % 3 == 0) {
+        d.pop_front();
+      }
+    }
+    while (!d.empty()) {
+      d.pop_back();
+    }
+  });
+}
+
+int main() {
+  printf("%-15s %16s %20s\n", "", "std::allocator", "SizeClassAllocator");
+  printf("%-15s %15.3fs %19.3fs\n", "vector", vectorBench<std::allocator>(),
+         vectorBench<SizeClassAllocator>());
+  printf("%-15s %15.3fs %19.3fs\n", "string", stringBench<std::allocator>(),
+         stringBench<SizeClassAllocator>());
+  printf("%-15s %15.3fs %19.3fs\n", "unordered_map", mapBench<std::allocator>(),
+         mapBench<SizeClassAllocator>());
+  printf("%-15s %15.3fs %19.3fs\n", "deque", dequeBench<std::allocator>(),
+         dequeBench<SizeClassAllocator>());
+  return 0;
+}
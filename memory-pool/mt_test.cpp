@@ -0,0 +1,163 @@
+/*-
+ * test.cpp 的多线程版本: 对比 std::allocator、加了一把全局锁的 MemoryPool
+ * 和 ConcurrentMemoryPool 在多个线程同时分配/释放时的吞吐
+ *
+ * 1. 每个线程一个 StackAlloc，各自 push 再 pop (同一线程分配和释放)
+ * 2. 每个线程先分配一批节点，然后释放相邻线程分配的那一批 (跨线程释放)
+ *
+ * 每个线程的工作量固定，线程数翻倍时理想情况下总吞吐也翻倍
+ * 编译: make mem_pool_mt_test
+ */
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "ConcurrentMemoryPool.h"
+#include "MemoryPool.h"
+#include "StackAlloc.h"
+
+#define ELEMS 1000000
+#define REPS 10
+#define CROSS_ELEMS 100000
+
+/*
+ * 所有线程共用一个 MemoryPool，用一把 mutex 保护，
+ * 对应 "给 MemoryPool 加一把锁" 的做法
+ */
+template <typename T> class LockedMemoryPool {
+public:
+  typedef T value_type;
+  template <typename U> struct rebind { typedef LockedMemoryPool<U> other; };
+
+  LockedMemoryPool() noexcept {}
+  template <class U> LockedMemoryPool(const LockedMemoryPool<U> &) noexcept {}
+
+  T *allocate(size_t n = 1) {
+    std::lock_guard<std::mutex> lg(mu_());
+    return pool_().allocate(n);
+  }
+  void deallocate(T *p, size_t n = 1) {
+    std::lock_guard<std::mutex> lg(mu_());
+    pool_().deallocate(p, n);
+  }
+  template <typename U, typename... Args> void construct(U *p, Args &&... args) {
+    new (p) U(std::forward<Args>(args)...);
+  }
+  template <typename U> void destroy(U *p) { p->~U(); }
+
+private:
+  static MemoryPool<T> &pool_() {
+    static MemoryPool<T> pool;
+    return pool;
+  }
+  static std::mutex &mu_() {
+    static std::mutex mu;
+    return mu;
+  }
+};
+
+// 所有线程到齐之后一起开始下一阶段
+class Barrier {
+public:
+  explicit Barrier(int n) : n_(n), waiting_(0), generation_(0) {}
+  void wait() {
+    std::unique_lock<std::mutex> ul(mu_);
+    size_t gen = generation_;
+    if (++waiting_ == n_) {
+      waiting_ = 0;
+      generation_++;
+      cv_.notify_all();
+    } else {
+      cv_.wait(ul, [&] { return gen != generation_; });
+    }
+  }
+
+private:
+  std::mutex mu_;
+  std::condition_variable cv_;
+  int n_;
+  int waiting_;
+  size_t generation_;
+};
+
+template <typename Func> double runThreads(int threads, Func func) {
+  std::vector<std::thread> ts;
+  auto start = std::chrono::steady_clock::now();
+  for (int id = 0; id < threads; id++) {
+    ts.push_back(std::thread(func, id));
+  }
+  for (auto &t : ts) {
+    t.join();
+  }
+  std::chrono::duration<double> diff = std::chrono::steady_clock::now() - start;
+  return diff.count();
+}
+
+// 每个线程 push ELEMS 个再全部 pop，重复 REPS 次，返回每秒的 push + pop 次数
+template <typename Alloc> double stackBench(int threads) {
+  double secs = runThreads(threads, [](int) {
+    StackAlloc<int, Alloc> stack;
+    for (int j = 0; j < REPS; j++) {
+      assert(stack.empty());
+      for (int i = 0; i < ELEMS; i++) {
+        stack.push(i);
+      }
+      for (int i = 0; i < ELEMS; i++) {
+        stack.pop();
+      }
+    }
+  });
+  return 2.0 * threads * ELEMS * REPS / secs;
+}
+
+// 每个线程分配 CROSS_ELEMS 个节点，等所有线程分配完，
+// 再释放下一个线程分配的那些，重复 REPS 次
+template <typename Alloc> double crossBench(int threads) {
+  typedef typename Alloc::template rebind<StackNode_<int> >::other Allocator;
+  std::vector<std::vector<StackNode_<int> *> > nodes(threads);
+  Barrier barrier(threads);
+  double secs = runThreads(threads, [&](int id) {
+    Allocator alloc;
+    std::vector<StackNode_<int> *> &mine = nodes[id];
+    std::vector<StackNode_<int> *> &next = nodes[(id + 1) % threads];
+    mine.resize(CROSS_ELEMS);
+    for (int j = 0; j < REPS; j++) {
+      for (int i = 0; i < CROSS_ELEMS; i++) {
+        mine[i] = alloc.allocate(1);
+        mine[i]->data = i;
+      }
+      barrier.wait();
+      for (int i = 0; i < CROSS_ELEMS; i++) {
+        alloc.deallocate(next[i], 1);
+      }
+      barrier.wait();
+    }
+  });
+  return 2.0 * threads * CROSS_ELEMS * REPS / secs;
+}
+
+int main() {
+  int n = std::max(1u, std::thread::hardware_concurrency());
+  for (int threads = 1; threads <= n; threads <<= 1) {
+    printf("%2d threads:\n", threads);
+    printf("\tstack, std::allocator:        %12.0f ops/sec\n",
+           stackBench<std::allocator<int> >(threads));
+    printf("\tstack, MemoryPool + mutex:    %12.0f ops/sec\n",
+           stackBench<LockedMemoryPool<int> >(threads));
+    printf("\tstack, ConcurrentMemoryPool:  %12.0f ops/sec\n",
+           stackBench<ConcurrentMemoryPool<int> >(threads));
+    printf("\tcross, std::allocator:        %12.0f ops/sec\n",
+           crossBench<std::allocator<int> >(threads));
+    printf("\tcross, MemoryPool + mutex:    %12.0f ops/sec\n",
+           crossBench<LockedMemoryPool<int> >(threads));
+    printf("\tcross, ConcurrentMemoryPool:  %12.0f ops/sec\n",
+           crossBench<ConcurrentMemoryPool<int> >(threads));
+  }
+  return 0;
+}
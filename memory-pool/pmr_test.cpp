@@ -0,0 +1,122 @@
+/*-
+ * std::pmr 容器使用不同 memory_resource 时的耗时
+ *
+ * 1. 模拟处理请求: 每个请求分配一堆 string/vector/unordered_map，请求结束时全部销毁
+ *      global heap                 new_delete_resource，也就是普通的 new/delete
+ *      monotonic_buffer_resource   标准库的单调分配器，每个请求新建一个
+ *      Arena                       每个请求结束时 reset()，Block 留给下一个请求
+ * 2. 节点反复插入删除的 pmr::list，global heap 对比 PoolResource
+ * 开始之前先检查 Arena 在 Block 末尾的大对齐分配不会越界
+ *
+ * 编译: make mem_pool_pmr_test (需要 -std=c++17)
+ */
+
+#include <cassert>
+#include <chrono>
+#include <cstdio>
+#include <list>
+#include <memory_resource>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "Arena.h"
+#include "PmrResource.h"
+
+#define REQUESTS 100000
+#define LIST_OPS 5000000
+
+size_t sink = 0; // 防止请求处理被优化掉
+
+// 一个请求: 解析出一些 header 和参数，再拼出响应
+void handleRequest(std::pmr::memory_resource *mr, int id) {
+  std::pmr::vector<std::pmr::string> headers(mr);
+  std::pmr::unordered_map<std::pmr::string, std::pmr::string> params(mr);
+  for (int i = 0; i < 16; i++) {
+    std::pmr::string name("X-Request-Header-", mr);
+    name += std::to_string(i);
+    headers.push_back(name);
+    params.emplace(name, std::pmr::string("some parameter value", mr));
+  }
+  std::pmr::vector<int> body(mr);
+  for (int i = 0; i < 256; i++) {
+    body.push_back(id + i);
+  }
+  std::pmr::string response("HTTP/1.1 200 OK\r\n", mr);
+  for (const std::pmr::string &h : headers) {
+    response += h;
+    response += ": ";
+    response += params[h];
+    response += "\r\n";
+  }
+  sink += response.size() + body.back();
+}
+
+template <typename Func> double timeIt(Func func) {
+  auto start = std::chrono::steady_clock::now();
+  func();
+  std::chrono::duration<double> diff = std::chrono::steady_clock::now() - start;
+  return diff.count();
+}
+
+// Block 只剩 8 个字节时按 256 对齐分配 8 个字节: 对齐之后已经超出 Block，必须换新的 Block
+void checkArenaAlignment() {
+  const size_t blockSize = 256;
+  Arena arena(blockSize);
+  char *first = static_cast<char *>(arena.allocate(1, 1));
+  void *firstBlock = arena.mark().block;
+  char *end = static_cast<char *>(firstBlock) + blockSize;
+  arena.allocate(end - first - 1 - 8, 1);
+  char *p = static_cast<char *>(arena.allocate(8, 256));
+  char *block = static_cast<char *>(arena.mark().block);
+  assert(block != firstBlock);
+  assert(reinterpret_cast<uintptr_t>(p) % 256 == 0);
+  assert(p > block && p + 8 <= block + (arena.capacity() - blockSize));
+  (void)p;
+  (void)block;
+}
+
+int main() {
+  checkArenaAlignment();
+  printf("%d requests:\n", REQUESTS);
+  printf("\tglobal heap:                %.3fs\n", timeIt([] {
+           for (int id = 0; id < REQUESTS; id++) {
+             handleRequest(std::pmr::new_delete_resource(), id);
+           }
+         }));
+  printf("\tmonotonic_buffer_resource:  %.3fs\n", timeIt([] {
+           for (int id = 0; id < REQUESTS; id++) {
+             std::pmr::monotonic_buffer_resource mr;
+             handleRequest(&mr, id);
+           }
+         }));
+  printf("\tArena (reset per request):  %.3fs\n", timeIt([] {
+           Arena arena;
+           ArenaResource mr(arena);
+           for (int id = 0; id < REQUESTS; id++) {
+             handleRequest(&mr, id);
+             arena.reset();
+           }
+         }));
+
+  // 每次插入一个新节点，删掉最老的节点，链表长度保持不变
+  auto listChurn = [](std::pmr::memory_resource *mr) {
+    std::pmr::list<int> list(mr);
+    for (int i = 0; i < 1000; i++) {
+      list.push_back(i);
+    }
+    for (int i = 0; i < LIST_OPS; i++) {
+      list.push_back(i);
+      list.pop_front();
+    }
+    sink += list.back();
+  };
+  printf("%d list push_back + pop_front:\n", LIST_OPS);
+  printf("\tglobal heap:                %.3fs\n",
+         timeIt([&] { listChurn(std::pmr::new_delete_resource()); }));
+  printf("\tPoolResource:               %.3fs\n", timeIt([&] {
+           PoolResource<32> mr; // list<int> 的节点: 两个指针加一个 int
+           listChurn(&mr);
+         }));
+  return sink == 0;
+}
@@ -0,0 +1,149 @@
+/*-
+ * MemoryPool 的统计
+ *
+ * 1. StackAlloc 反复 push/pop，对比不统计 (NoPoolStats)、统计 (PoolStats<>)、
+ *    统计并平均每 1024 次分配采样一次分配位置 (PoolStats<1024>) 的耗时
+ * 2. 模拟一个服务: 工作线程使用带统计的内存池，另一个线程每隔一段时间 snapshot()，
+ *    打印存活对象个数、最大值、Block 个数、空闲链表长度和分配速率
+ * 3. 打印采样到的分配位置 (用 dladdr 找函数名，链接时需要 -rdynamic)
+ *
+ * 编译: make mem_pool_stats_test
+ */
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <ctime>
+#include <thread>
+#include <vector>
+
+#include <dlfcn.h>
+
+#include "MemoryPool.h"
+#include "PoolStats.h"
+#include "StackAlloc.h"
+
+#define ELEMS 1000000
+#define REPS 50
+
+template <typename Alloc> double stackBench() {
+  StackAlloc<int, Alloc> stack;
+  clock_t start = clock();
+  for (int j = 0; j < REPS; j++) {
+    for (int i = 0; i < ELEMS; i++) {
+      stack.push(i);
+    }
+    for (int i = 0; i < ELEMS; i++) {
+      stack.pop();
+    }
+  }
+  return ((double)clock() - start) / CLOCKS_PER_SEC;
+}
+
+struct Order {
+  long id;
+  double price;
+  Order *next;
+};
+
+typedef PoolStats<64> OrderStats;
+typedef MemoryPool<Order, 4096, HeapBlockSource, OrderStats> OrderPool;
+
+// 采样记录的是 allocate 所在函数的返回地址: allocate 内联到 newOrder/newCancel 中，
+// 记录下来的就是 runOrders 中调用它们的两个位置
+__attribute__((noinline)) Order *newOrder(OrderPool &pool, long id, double price) {
+  Order *order = pool.allocate();
+  order->id = id;
+  order->price = price;
+  return order;
+}
+
+__attribute__((noinline)) Order *newCancel(OrderPool &pool, long id) {
+  Order *order = pool.allocate();
+  order->id = -id;
+  order->price = 0;
+  return order;
+}
+
+// 订单不断进来，存活的订单数先涨后落，最后全部释放并 trim
+void runOrders(OrderPool &pool, int rounds) {
+  std::vector<Order *> live;
+  for (int round = 0; round < rounds; round++) {
+    size_t target = (round % 8 < 4 ? round % 8 + 1 : 8 - round % 8) * 100000;
+    for (long i = 0; i < 2000000; i++) {
+      if (live.size() < target || i % 2 == 0) {
+        if (i % 8 == 0) {
+          live.push_back(newCancel(pool, i));
+        } else {
+          live.push_back(newOrder(pool, i, i * 0.5));
+        }
+      } else {
+        pool.deallocate(live.back());
+        live.pop_back();
+      }
+    }
+    while (live.size() > target) {
+      pool.deallocate(live.back());
+      live.pop_back();
+    }
+  }
+  for (Order *order : live) {
+    pool.deallocate(order);
+  }
+  pool.trim();
+}
+
+void printSnapshot(const PoolSnapshot &s, double rate) {
+  printf("\t%6.2fs  live %8zu  high water %8zu  blocks %5zu  free list %8zu  "
+         "%6.2f M alloc/s\n",
+         s.seconds, s.live, s.highWater, s.blocks, s.freeList, rate / 1e6);
+}
+
+int main() {
+  printf("sizeof(MemoryPool<int>): NoPoolStats %zu, PoolStats<> %zu\n\n",
+         sizeof(MemoryPool<int>),
+         sizeof(MemoryPool<int, 4096, HeapBlockSource, PoolStats<> >));
+  printf("StackAlloc %d push + pop, %d reps:\n", ELEMS, REPS);
+  printf("\tNoPoolStats:     %.3fs\n", stackBench<MemoryPool<int> >());
+  printf("\tPoolStats<>:     %.3fs\n",
+         stackBench<MemoryPool<int, 4096, HeapBlockSource, PoolStats<> > >());
+  printf("\tPoolStats<1024>: %.3fs\n",
+         stackBench<MemoryPool<int, 4096, HeapBlockSource, PoolStats<1024> > >());
+
+  // 工作线程使用内存池，主线程每 50ms 读一次统计
+  OrderPool pool;
+  std::atomic<bool> done(false);
+  std::thread worker([&] {
+    runOrders(pool, 24);
+    done.store(true);
+  });
+
+  // 监控线程只读统计，不碰内存池本身
+  printf("snapshots:\n");
+  PoolSnapshot last = pool.stats().snapshot();
+  while (!done.load()) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    PoolSnapshot now = pool.stats().snapshot();
+    printSnapshot(now, allocationRate(last, now));
+    last = now;
+  }
+  worker.join();
+  PoolSnapshot end = pool.stats().snapshot();
+  printf("after trim:\n");
+  printSnapshot(end, allocationRate(last, end));
+
+  printf("sampled allocation sites (1 in 64 allocations):\n");
+  PoolSite sites[OrderStats::MAX_SITES];
+  size_t n = pool.stats().sites(sites, OrderStats::MAX_SITES);
+  for (size_t i = 0; i < n; i++) {
+    Dl_info info;
+    if (dladdr(sites[i].address, &info) != 0 && info.dli_sname != nullptr) {
+      printf("\t%s+%#lx\t%zu\n", info.dli_sname,
+             (unsigned long)((char *)sites[i].address - (char *)info.dli_saddr),
+             sites[i].count);
+    } else {
+      printf("\t%p\t%zu\n", sites[i].address, sites[i].count);
+    }
+  }
+  return 0;
+}
@@ -8,8 +8,8 @@
 
 using namespace mem;
 
-Writer::Writer(size_t size_lim, std::string file_path)
-    : size_lim_(size_lim), file_path_(file_path), cur_pos_(0), pending_(0) {
+MappedFile::MappedFile(size_t size_lim, std::string file_path)
+    : size_lim_(size_lim), file_path_(file_path), cur_pos_(0) {
   int fd = open(file_path_.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
   if (fd == -1) {
     printf("Open file %s failed.\n", file_path_.c_str());
@@ -27,11 +27,10 @@ Writer::Writer(size_t size_lim, std::string file_path)
     exit(-1);
   }
 
-  spinlock_.clear(std::memory_order_release);
   close(fd);
 }
 
-Writer::~Writer() {
+MappedFile::~MappedFile() {
   if (munmap(mem_file_ptr_, size_lim_) == -1) {
     printf("Unmap failed.\n");
   }
@@ -41,34 +40,7 @@ Writer::~Writer() {
   mem_file_ptr_ = nullptr;
 }
 
-void Writer::write_data(const char *data, size_t len) {
-  /* 这两条语句中间可能被打断，并不是安全的
-  size_t old_pos = cur_pos_.load();
-  cur_pos_ += len;
-  */
-  while (spinlock_.test_and_set(std::memory_order_acquire)) {
-    // acquire spinlock
-    // atomically set flag to true and return previous value
-  }
-  size_t old_pos = cur_pos_;
-  cur_pos_ += len;
-  if (cur_pos_ > size_lim_) {
-    remap(size_lim_ << 1);
-  }
-  spinlock_.clear(std::memory_order_release); // release spinlock
-
-  pending_ += 1;
-  std::memcpy((char *)mem_file_ptr_ + old_pos, data, len);
-  pending_ -= 1;
-}
-
-void Writer::remap(size_t new_size) {
-  // should be very time consuming, try to avoid
-
-  // wait for all pending memcpy
-  while (pending_ != 0) {
-  }
-
+void MappedFile::remap(size_t new_size) {
   void *new_addr = mremap(mem_file_ptr_, size_lim_, new_size, MREMAP_MAYMOVE);
   if (new_addr == MAP_FAILED) {
     printf("Panic when try to remap...\n");
@@ -1,24 +1,73 @@
 #pragma once
-#include <atomic>
+#include <cstring> // for memcpy()
+#include <mutex>
 #include <string>
 
+#include "../sync/backoff.h"
+#include "../sync/sharded_counter.h"
+#include "../sync/spinlock.h"
+
 namespace mem {
-class Writer {
+// 映射到内存的文件，不负责同步
+class MappedFile {
 public:
-  explicit Writer(size_t size_lim, const std::string file_path);
-  ~Writer();
-  void write_data(const char *data, size_t len);
+  explicit MappedFile(size_t size_lim, const std::string file_path);
+  // 文件截断到实际写入的大小
+  ~MappedFile();
 
-private:
+protected:
   size_t size_lim_;
   void *mem_file_ptr_;
   std::string file_path_;
-  // UPDATE: use a spinlock, so we don't need it to be atomic
   size_t cur_pos_;
 
-  // for remap when overflow
-  std::atomic_flag spinlock_;
-  std::atomic<size_t> pending_;
+  // 调用者保证没有人在读写映射的内存
   void remap(size_t new_size);
 };
+
+// 多个线程并行写入同一个文件，Lock 保护写入位置和 remap，可以换成
+// std::mutex 或 ../sync 中的锁 (concurrency::TicketLock, MCSLock, HybridMutex ...)
+template <typename Lock = concurrency::SpinLock>
+class Writer : private MappedFile {
+public:
+  explicit Writer(size_t size_lim, const std::string file_path)
+      : MappedFile(size_lim, file_path) {}
+
+  void write_data(const char *data, size_t len) {
+    /* 这两条语句中间可能被打断，并不是安全的
+    size_t old_pos = cur_pos_.load();
+    cur_pos_ += len;
+    */
+    char *dest;
+    {
+      std::lock_guard<Lock> lg(lock_);
+      size_t old_pos = cur_pos_;
+      cur_pos_ += len;
+      if (cur_pos_ > size_lim_) {
+        remap(size_lim_ << 1);
+      }
+      dest = (char *)mem_file_ptr_ + old_pos;
+      // 在放锁之前登记，否则放锁之后、登记之前另一个线程可能开始 remap
+      pending_.add(1);
+    }
+    std::memcpy(dest, data, len);
+    pending_.sub(1, std::memory_order_release);
+  }
+
+private:
+  Lock lock_;
+  // for remap when overflow
+  // 每个线程加减自己的分片，写入的线程之间不再抢同一个缓存行
+  concurrency::ShardedCounter<> pending_;
+
+  void remap(size_t new_size) {
+    // should be very time consuming, try to avoid
+
+    // wait for all pending memcpy
+    // 持有锁时不会再有 add(1)，每个分片只会变小，所以扫描出来的和不小于扫描结束时的真实值，
+    // 读到 0 就说明真的都写完了
+    concurrency::spinUntil([this] { return pending_.read(std::memory_order_acquire) == 0; });
+    MappedFile::remap(new_size);
+  }
+};
 }
@@ -7,42 +7,34 @@
 #include <chrono>
 
 #include "mmapper.h"
+#include "../sync/sync.h"
 
 #define FILE_SIZE_LIM 1<<10
+#define WRITES_PER_THREAD 100000
 
-int main(int argc, const char* argv[]) {
-  if (argc != 2) {
-    printf("Usage: %s <file_to_write>\n", argv[0]);
-    exit(0);
-  }
-
-  mem::Writer writer(FILE_SIZE_LIM, std::string(argv[1]));
+// 用 Lock 保护写入位置，所有线程写完之后打印耗时
+template <typename Lock>
+void parallel_write(const char *lock_name, const char *path,
+                    const std::vector<std::string> &words) {
+  mem::Writer<Lock> writer(FILE_SIZE_LIM, std::string(path));
   std::atomic<size_t> total(0);
 
   int THREAD_NUM = std::thread::hardware_concurrency();
 
-  // 读取要写入的单词
-  std::ifstream infile("words.txt");
-  std::vector<std::string> words;
-  std::string line;
-  while (getline(infile, line)) {
-    words.push_back(std::move(line));
-  }
-
   auto start = std::chrono::steady_clock::now();
   std::vector<std::thread> threads;
   for (int i=0; i<THREAD_NUM; i++) {
-    threads.emplace_back([&](){
+    threads.emplace_back([&, i](){
       std::string word_with_space = words[i % words.size()] + " ";
       const char *s = word_with_space.c_str();
       size_t len = word_with_space.size();
-      for (int i=0; i< 1000; i++) {
+      for (int i=0; i< WRITES_PER_THREAD; i++) {
         writer.write_data(s, len);
       }
-      size_t byte_num = len*1000;
+      size_t byte_num = len*WRITES_PER_THREAD;
       total += byte_num;
       printf("Thread %08x put %lu bytes to file %s\n",
-       std::this_thread::get_id(), byte_num, argv[1]);
+       std::this_thread::get_id(), byte_num, path);
     });
   }
 
@@ -52,6 +44,28 @@ int main(int argc, const char* argv[]) {
 
   auto end = std::chrono::steady_clock::now();
   std::chrono::duration<double> diff = end-start;
-  printf("Write complete, %d threads write %lu bytes in %.3f ms\n", THREAD_NUM, total.load(), diff*1000);
+  printf("[%s] Write complete, %d threads write %lu bytes in %.3f ms\n", lock_name, THREAD_NUM, total.load(), diff.count()*1000);
+}
+
+int main(int argc, const char* argv[]) {
+  if (argc != 2) {
+    printf("Usage: %s <file_to_write>\n", argv[0]);
+    exit(0);
+  }
+
+  // 读取要写入的单词
+  std::ifstream infile("words.txt");
+  std::vector<std::string> words;
+  std::string line;
+  while (getline(infile, line)) {
+    words.push_back(std::move(line));
+  }
+
+  // 同样的写入换不同的锁，文件里留下的是最后一次写入的内容
+  parallel_write<concurrency::SpinLock>("spinlock", argv[1], words);
+  parallel_write<concurrency::TicketLock>("ticket", argv[1], words);
+  parallel_write<concurrency::MCSLock>("mcs", argv[1], words);
+  parallel_write<concurrency::HybridMutex>("hybrid_mutex", argv[1], words);
+  parallel_write<std::mutex>("std::mutex", argv[1], words);
   return 0;
 }
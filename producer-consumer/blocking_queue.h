@@ -0,0 +1,239 @@
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <utility>
+
+#include "circular_buf.h"
+
+// 有界阻塞队列，多生产者多消费者
+//
+// - "不满" 和 "不空" 用两个 condition_variable，push 只唤醒消费者，pop 只唤醒生产者，
+//   不会出现 notify_one 叫醒了同一边的线程、真正需要的那一边却还在睡的情况
+// - 记录每一边正在等待的线程数，没人等的时候不调用 notify
+// - notify 在解锁之后调用，被唤醒的线程不会马上又阻塞在锁上
+// - push_n/pop_n 一次加锁搬运多个元素
+// - close() 之后 push 失败，pop 把剩下的元素取完后失败，所有等待的线程都会被唤醒
+template <typename T> class BlockingQueue {
+public:
+  explicit BlockingQueue(size_t n)
+      : buf_(n), push_waiters_(0), pop_waiters_(0), closed_(false) {}
+
+  BlockingQueue(const BlockingQueue &) = delete;
+  BlockingQueue &operator=(const BlockingQueue &) = delete;
+
+  inline size_t capacity() const { return buf_.capacity(); }
+
+  size_t size() {
+    std::lock_guard<std::mutex> lg(mu_);
+    return buf_.size();
+  }
+
+  void close() {
+    {
+      std::lock_guard<std::mutex> lg(mu_);
+      closed_ = true;
+    }
+    not_full_.notify_all();
+    not_empty_.notify_all();
+  }
+
+  bool closed() {
+    std::lock_guard<std::mutex> lg(mu_);
+    return closed_;
+  }
+
+  // 持有锁依次访问队列中的元素，用于调试打印，visitor 里不要再操作队列
+  template <typename F> void for_each(F &&visitor) {
+    std::lock_guard<std::mutex> lg(mu_);
+    buf_.for_each(std::forward<F>(visitor));
+  }
+
+  /**********
+  * 生产者 *
+  **********/
+  // 满时阻塞，已关闭时返回 false
+  bool push(const T &t) { return push_until_(t, nullptr); }
+  bool push(T &&t) { return push_until_(std::move(t), nullptr); }
+
+  // 最多等待 timeout，超时或已关闭时返回 false
+  // 失败时不会 move 走 t，调用者的对象保持原样 (unique_ptr 这类只能移动的元素不会丢)
+  template <typename Rep, typename Period>
+  bool push_for(const T &t, const std::chrono::duration<Rep, Period> &timeout) {
+    auto deadline = std::chrono::steady_clock::now() + timeout;
+    return push_until_(t, &deadline);
+  }
+  template <typename Rep, typename Period>
+  bool push_for(T &&t, const std::chrono::duration<Rep, Period> &timeout) {
+    auto deadline = std::chrono::steady_clock::now() + timeout;
+    return push_until_(std::move(t), &deadline);
+  }
+
+  // 不阻塞，满或已关闭时返回 false，同样失败时不会 move 走 t
+  bool try_push(const T &t) { return try_push_(t); }
+  bool try_push(T &&t) { return try_push_(std::move(t)); }
+
+  // 把 [first, first + n) 依次 move 进队列，有空间就一次放入尽可能多的元素
+  // 返回放入的个数，只有关闭时才会小于 n
+  template <typename It> size_t push_n(It first, size_t n) {
+    size_t pushed = 0;
+    while (pushed < n) {
+      size_t k = 0;
+      bool wake;
+      {
+        std::unique_lock<std::mutex> ul(mu_);
+        if (!wait_(ul, not_full_, push_waiters_,
+                   [this] { return closed_ || !buf_.full(); }, nullptr) ||
+            closed_) {
+          return pushed;
+        }
+        for (; pushed < n && buf_.try_push(std::move(*first)); ++pushed, ++first) {
+          k++;
+        }
+        wake = pop_waiters_ != 0;
+      }
+      if (wake) {
+        notify_(not_empty_, k);
+      }
+    }
+    return pushed;
+  }
+
+  /**********
+  * 消费者 *
+  **********/
+  // 空时阻塞，已关闭并且取完时返回 false
+  bool pop(T &t) { return pop_until_(t, nullptr); }
+
+  template <typename Rep, typename Period>
+  bool pop_for(T &t, const std::chrono::duration<Rep, Period> &timeout) {
+    auto deadline = std::chrono::steady_clock::now() + timeout;
+    return pop_until_(t, &deadline);
+  }
+
+  bool try_pop(T &t) {
+    bool wake;
+    {
+      std::lock_guard<std::mutex> lg(mu_);
+      if (!buf_.try_pop(t)) {
+        return false;
+      }
+      wake = push_waiters_ != 0;
+    }
+    if (wake) {
+      not_full_.notify_one();
+    }
+    return true;
+  }
+
+  // 空时阻塞，之后一次取出尽可能多的元素(最多 max 个)依次 move 到 out
+  // 返回取出的个数，已关闭并且取完时返回 0
+  template <typename It> size_t pop_n(It out, size_t max) {
+    size_t k = 0;
+    bool wake;
+    {
+      std::unique_lock<std::mutex> ul(mu_);
+      if (!wait_(ul, not_empty_, pop_waiters_,
+                 [this] { return closed_ || !buf_.empty(); }, nullptr)) {
+        return 0;
+      }
+      for (; k < max && buf_.try_pop(*out); ++k, ++out) {
+      }
+      wake = push_waiters_ != 0;
+    }
+    if (wake) {
+      notify_(not_full_, k);
+    }
+    return k;
+  }
+
+private:
+  // 确认有空间之后才构造元素
+  template <typename U> bool try_push_(U &&t) {
+    bool wake;
+    {
+      std::lock_guard<std::mutex> lg(mu_);
+      if (closed_ || !buf_.try_push(std::forward<U>(t))) {
+        return false;
+      }
+      wake = pop_waiters_ != 0;
+    }
+    if (wake) {
+      not_empty_.notify_one();
+    }
+    return true;
+  }
+
+  template <typename U>
+  bool push_until_(U &&t, const std::chrono::steady_clock::time_point *deadline) {
+    bool wake;
+    {
+      std::unique_lock<std::mutex> ul(mu_);
+      if (!wait_(ul, not_full_, push_waiters_,
+                 [this] { return closed_ || !buf_.full(); }, deadline) ||
+          closed_) {
+        return false;
+      }
+      buf_.try_push(std::forward<U>(t));
+      wake = pop_waiters_ != 0;
+    }
+    if (wake) {
+      not_empty_.notify_one();
+    }
+    return true;
+  }
+
+  bool pop_until_(T &t, const std::chrono::steady_clock::time_point *deadline) {
+    bool wake;
+    {
+      std::unique_lock<std::mutex> ul(mu_);
+      if (!wait_(ul, not_empty_, pop_waiters_,
+                 [this] { return closed_ || !buf_.empty(); }, deadline) ||
+          !buf_.try_pop(t)) {
+        return false;
+      }
+      wake = push_waiters_ != 0;
+    }
+    if (wake) {
+      not_full_.notify_one();
+    }
+    return true;
+  }
+
+  // 等待期间把自己计入 waiters，deadline 为空表示一直等，超时返回 false
+  template <typename Pred>
+  bool wait_(std::unique_lock<std::mutex> &ul, std::condition_variable &cv,
+             size_t &waiters, Pred pred,
+             const std::chrono::steady_clock::time_point *deadline) {
+    if (pred()) {
+      return true;
+    }
+    waiters++;
+    bool ok = true;
+    if (deadline == nullptr) {
+      cv.wait(ul, pred);
+    } else {
+      ok = cv.wait_until(ul, *deadline, pred);
+    }
+    waiters--;
+    return ok;
+  }
+
+  // 放入/取出了 k 个元素，最多需要唤醒 k 个线程
+  inline void notify_(std::condition_variable &cv, size_t k) {
+    if (k == 1) {
+      cv.notify_one();
+    } else if (k > 1) {
+      cv.notify_all();
+    }
+  }
+
+  CircularBuf<T> buf_;
+  std::mutex mu_;
+  std::condition_variable not_full_;
+  std::condition_variable not_empty_;
+  size_t push_waiters_;
+  size_t pop_waiters_;
+  bool closed_;
+};
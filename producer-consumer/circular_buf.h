@@ -1,15 +1,54 @@
 #pragma once
 #include <stdint.h>
-#include <vector>
-#include <stdexcept>
+#include <memory>
+#include <new>
+#include <ostream>
 #include <sstream>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
 
 template<typename T>
 class CircularBuf {
 public:
-  explicit CircularBuf(size_t n) {
-    buf_ = std::vector<T>(n);
-    item_num_ = before_ = rear_ = 0;
+  // 实际分配的槽位数向上取整到 2 的幂，下标用 & mask_ 代替取模，
+  // 但能放的元素个数仍然是 n
+  explicit CircularBuf(size_t n) : capacity_(n), item_num_(0), head_(0) {
+    size_t slots = 1;
+    while (slots < n) {
+      slots <<= 1;
+    }
+    mask_ = slots - 1;
+    // 只分配内存，不默认构造元素，T 不需要有默认构造函数
+    buf_.reset(new Storage_[slots]);
+  }
+
+  CircularBuf(const CircularBuf& other) : CircularBuf(other.capacity_) {
+    other.for_each([this](const T& t) { emplace(t); });
+  }
+
+  CircularBuf(CircularBuf&& other) noexcept
+      : buf_(std::move(other.buf_)), capacity_(other.capacity_),
+        mask_(other.mask_), item_num_(other.item_num_), head_(other.head_) {
+    other.capacity_ = other.item_num_ = other.head_ = other.mask_ = 0;
+  }
+
+  CircularBuf& operator=(CircularBuf other) noexcept {
+    swap(other);
+    return *this;
+  }
+
+  ~CircularBuf() {
+    clear();
+  }
+
+  void swap(CircularBuf& other) noexcept {
+    std::swap(buf_, other.buf_);
+    std::swap(capacity_, other.capacity_);
+    std::swap(mask_, other.mask_);
+    std::swap(item_num_, other.item_num_);
+    std::swap(head_, other.head_);
   }
 
   inline bool empty() const {
@@ -17,74 +56,148 @@ public:
   }
 
   inline bool full() const {
-    return item_num_ == buf_.size();
+    return item_num_ == capacity_;
   }
 
   inline size_t capacity() const {
-    return buf_.size();
+    return capacity_;
   }
 
   inline size_t size() const {
     return item_num_;
   }
 
+  // 从队头到队尾依次访问每个元素，不分配内存
+  template <typename F>
+  inline void for_each(F&& visitor) const {
+    for (size_t i = 0; i < item_num_; i++) {
+      visitor(at_(head_ + i));
+    }
+  }
+
+  // 输出成 [a b c] 的形式
+  void print(std::ostream& os) const {
+    os << "[";
+    size_t i = 0;
+    for_each([&](const T& t) {
+      os << t;
+      if (++i != item_num_) {
+        os << " ";
+      }
+    });
+    os << "]";
+  }
+
   std::string str() const {
-    auto elems = this->items();
     std::ostringstream oss;
-    oss << "[";
-    for (size_t i = 0; i < elems.size(); i++) {
-      oss << elems[i];
-      if (i != elems.size()-1) {
-        oss << " ";
-      }
-    }
-    oss << "]";
+    print(oss);
     return oss.str();
   }
 
+  // 会拷贝所有元素，热路径上请用 for_each
   inline std::vector<T> items() const {
     std::vector<T> ret;
-    size_t count = item_num_;
-    size_t curIdx = before_;
-    while(count != 0) {
-      curIdx = next(curIdx);
-      ret.push_back(buf_[curIdx]);
-      --count;
-    }
+    ret.reserve(item_num_);
+    for_each([&](const T& t) { ret.push_back(t); });
     return ret;
   };
 
-  // return true on success
-  inline void push(const T& t) {
-    if (item_num_ >= buf_.size()) {
+  // 在队尾原地构造，满时返回 false
+  template <typename... Args>
+  inline bool try_emplace(Args&&... args) {
+    if (item_num_ >= capacity_) {
+      return false;
+    }
+    new (slot_(head_ + item_num_)) T(std::forward<Args>(args)...);
+    item_num_ += 1;
+    return true;
+  }
+
+  inline bool try_push(const T& t) { return try_emplace(t); }
+  inline bool try_push(T&& t) { return try_emplace(std::move(t)); }
+
+  // 把队头元素 move 到 t，空时返回 false
+  inline bool try_pop(T& t) {
+    if (item_num_ == 0) {
+      return false;
+    }
+    t = std::move(at_(head_));
+    drop_front_();
+    return true;
+  }
+
+  // 以下几个满或空时抛出 std::logic_error
+  template <typename... Args>
+  inline void emplace(Args&&... args) {
+    if (!try_emplace(std::forward<Args>(args)...)) {
       throw std::logic_error("size exceeded.");
     }
-    rear_ = next(rear_);
-    buf_[rear_] = t;
-    item_num_ +=1;
   }
 
-  inline T poll() {
+  inline void push(const T& t) { emplace(t); }
+  inline void push(T&& t) { emplace(std::move(t)); }
+
+  // 把队头元素 move 出来
+  inline T pop() {
     if (item_num_ == 0) {
       throw std::logic_error("container is empty.");
     }
-    before_ = next(before_);
-    item_num_ -= 1;
-    return buf_[before_];
+    T t(std::move(at_(head_)));
+    drop_front_();
+    return t;
   }
 
-  inline T peek() const {
+  inline T poll() { return pop(); }
+
+  inline const T& peek() const {
     if (item_num_ == 0) {
       throw std::logic_error("container is empty.");
     }
-    return buf_[next(before_)];
+    return at_(head_);
   }
+
+  inline T& peek() {
+    if (item_num_ == 0) {
+      throw std::logic_error("container is empty.");
+    }
+    return at_(head_);
+  }
+
+  void clear() {
+    while (item_num_ != 0) {
+      drop_front_();
+    }
+    head_ = 0;
+  }
+
 private:
-  size_t next(size_t cur) const {
-    return cur+1 >= buf_.size()? 0:cur+1;
+  typedef typename std::aligned_storage<sizeof(T), alignof(T)>::type Storage_;
+
+  // const 版本只给出 const 的引用，const 的 CircularBuf 不能被 for_each/peek 改掉
+  inline T* slot_(size_t idx) {
+    return reinterpret_cast<T*>(&buf_[idx & mask_]);
   }
-  std::vector<T> buf_;
+  inline const T* slot_(size_t idx) const {
+    return reinterpret_cast<const T*>(&buf_[idx & mask_]);
+  }
+  inline T& at_(size_t idx) { return *slot_(idx); }
+  inline const T& at_(size_t idx) const { return *slot_(idx); }
+
+  inline void drop_front_() {
+    slot_(head_)->~T();
+    head_ = (head_ + 1) & mask_;
+    item_num_ -= 1;
+  }
+
+  std::unique_ptr<Storage_[]> buf_;
+  size_t capacity_;  // 最多能放的元素个数
+  size_t mask_;      // 槽位数 - 1
   size_t item_num_;
-  size_t before_;  // pop element from before_+1
-  size_t rear_; // insert element to rear
+  size_t head_;      // 队头元素所在的槽位
 };
+
+template <typename T>
+std::ostream& operator<<(std::ostream& os, const CircularBuf<T>& buf) {
+  buf.print(os);
+  return os;
+}
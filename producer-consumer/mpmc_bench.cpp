@@ -0,0 +1,179 @@
+// 所有核都在 push/pop 时，对比:
+//   1. producer_consumer.cpp 的做法: CircularBuf + 全局 mutex + 一个 condition_variable
+//   2. BlockingQueue 单个 push/pop，以及批量 push_n/pop_n
+//   3. MPMCQueue 单个 try_push/try_pop
+//   4. MPMCQueue 批量 try_push_n/try_pop_n
+// 编译: make mpmc_bench
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "blocking_queue.h"
+#include "circular_buf.h"
+#include "mpmc_queue.h"
+
+const size_t QUEUE_SIZE = 1024;
+const size_t ITEMS_PER_PRODUCER = 1000000;
+const size_t BATCH = 16;
+
+// 自旋一段时间后让出 CPU
+inline void backoff(size_t &spins) {
+  if (++spins > 64) {
+    std::this_thread::yield();
+    spins = 0;
+  }
+}
+
+// 一半线程生产，一半线程消费，返回每秒处理的元素个数
+template <typename Produce, typename Consume>
+double run(int pairs, Produce produce, Consume consume) {
+  std::vector<std::thread> threads;
+  auto start = std::chrono::steady_clock::now();
+  for (int id = 0; id < pairs; id++) {
+    threads.push_back(std::thread(produce));
+    threads.push_back(std::thread(consume));
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  auto end = std::chrono::steady_clock::now();
+  std::chrono::duration<double> diff = end - start;
+  return pairs * ITEMS_PER_PRODUCER / diff.count();
+}
+
+double mutexQueue(int pairs) {
+  CircularBuf<int> buf(QUEUE_SIZE);
+  std::mutex mu;
+  std::condition_variable cv;
+  auto produce = [&]() {
+    for (size_t i = 0; i < ITEMS_PER_PRODUCER; i++) {
+      std::unique_lock<std::mutex> ul(mu);
+      cv.wait(ul, [&] { return !buf.full(); });
+      buf.push(i);
+      ul.unlock();
+      // 两边共用一个条件变量，notify_one 可能叫醒同一边的线程，
+      // 每边不止一个线程时会全部睡死
+      cv.notify_all();
+    }
+  };
+  auto consume = [&]() {
+    for (size_t i = 0; i < ITEMS_PER_PRODUCER; i++) {
+      std::unique_lock<std::mutex> ul(mu);
+      cv.wait(ul, [&] { return !buf.empty(); });
+      buf.poll();
+      ul.unlock();
+      cv.notify_all();
+    }
+  };
+  return run(pairs, produce, consume);
+}
+
+double blockingQueue(int pairs) {
+  BlockingQueue<int> queue(QUEUE_SIZE);
+  auto produce = [&]() {
+    for (size_t i = 0; i < ITEMS_PER_PRODUCER; i++) {
+      queue.push(i);
+    }
+  };
+  auto consume = [&]() {
+    int item;
+    for (size_t i = 0; i < ITEMS_PER_PRODUCER; i++) {
+      queue.pop(item);
+    }
+  };
+  return run(pairs, produce, consume);
+}
+
+double blockingQueueBulk(int pairs) {
+  BlockingQueue<int> queue(QUEUE_SIZE);
+  auto produce = [&]() {
+    int items[BATCH];
+    for (size_t i = 0; i < ITEMS_PER_PRODUCER;) {
+      size_t n = std::min(BATCH, ITEMS_PER_PRODUCER - i);
+      for (size_t j = 0; j < n; j++) {
+        items[j] = i + j;
+      }
+      queue.push_n(items, n);
+      i += n;
+    }
+  };
+  auto consume = [&]() {
+    int items[BATCH];
+    for (size_t i = 0; i < ITEMS_PER_PRODUCER;) {
+      i += queue.pop_n(items, std::min(BATCH, ITEMS_PER_PRODUCER - i));
+    }
+  };
+  return run(pairs, produce, consume);
+}
+
+double mpmcQueue(int pairs) {
+  MPMCQueue<int> queue(QUEUE_SIZE);
+  auto produce = [&]() {
+    size_t spins = 0;
+    for (size_t i = 0; i < ITEMS_PER_PRODUCER; i++) {
+      while (!queue.try_push(i)) {
+        backoff(spins);
+      }
+    }
+  };
+  auto consume = [&]() {
+    size_t spins = 0;
+    int item;
+    for (size_t i = 0; i < ITEMS_PER_PRODUCER; i++) {
+      while (!queue.try_pop(item)) {
+        backoff(spins);
+      }
+    }
+  };
+  return run(pairs, produce, consume);
+}
+
+double mpmcQueueBulk(int pairs) {
+  MPMCQueue<int> queue(QUEUE_SIZE);
+  auto produce = [&]() {
+    size_t spins = 0;
+    int items[BATCH];
+    for (size_t i = 0; i < ITEMS_PER_PRODUCER;) {
+      size_t n = std::min(BATCH, ITEMS_PER_PRODUCER - i);
+      for (size_t j = 0; j < n; j++) {
+        items[j] = i + j;
+      }
+      size_t pushed = 0;
+      while (pushed < n) {
+        size_t k = queue.try_push_n(items + pushed, n - pushed);
+        if (k == 0) backoff(spins);
+        pushed += k;
+      }
+      i += n;
+    }
+  };
+  auto consume = [&]() {
+    size_t spins = 0;
+    int items[BATCH];
+    for (size_t i = 0; i < ITEMS_PER_PRODUCER;) {
+      size_t k = queue.try_pop_n(items,
+                                 std::min(BATCH, ITEMS_PER_PRODUCER - i));
+      if (k == 0) backoff(spins);
+      i += k;
+    }
+  };
+  return run(pairs, produce, consume);
+}
+
+int main(int argc, char const *argv[]) {
+  int n = std::max(2u, std::thread::hardware_concurrency());
+  for (int pairs = 1; pairs <= n / 2; pairs <<= 1) {
+    printf("%2d producers + %2d consumers:\n", pairs, pairs);
+    printf("\tmutex + condvar:   %12.0f items/sec\n", mutexQueue(pairs));
+    printf("\tBlockingQueue:     %12.0f items/sec\n", blockingQueue(pairs));
+    printf("\tBlockingQueue (bulk): %9.0f items/sec\n", blockingQueueBulk(pairs));
+    printf("\tMPMCQueue:         %12.0f items/sec\n", mpmcQueue(pairs));
+    printf("\tMPMCQueue (bulk):  %12.0f items/sec\n", mpmcQueueBulk(pairs));
+  }
+  return 0;
+}
@@ -0,0 +1,183 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+// L1d cache line 大小，可以用 getconf LEVEL1_DCACHE_LINESIZE 查询
+#ifndef CLS
+#define CLS 64
+#endif
+
+// 多生产者多消费者的有界无锁队列 (Dmitry Vyukov 的做法)
+//
+// 每个槽位带一个序号 seq:
+//   seq == pos       槽位空闲，可以由拿到 pos 的生产者写入
+//   seq == pos + 1   槽位已写入，可以由拿到 pos 的消费者读出
+// 读出后把 seq 设为 pos + capacity，即下一圈生产者的 pos
+// 生产者/消费者只在各自的位置计数器上做 CAS，互相之间只通过槽位的 seq 同步。
+template <typename T> class MPMCQueue {
+public:
+  // 容量会向上取整到 2 的幂
+  explicit MPMCQueue(size_t n) {
+    size_t size = 2;
+    while (size < n) {
+      size <<= 1;
+    }
+    mask_ = size - 1;
+    cells_ = new Cell_[size];
+    for (size_t i = 0; i < size; i++) {
+      cells_[i].seq.store(i, std::memory_order_relaxed);
+    }
+    enqueue_pos_.store(0, std::memory_order_relaxed);
+    dequeue_pos_.store(0, std::memory_order_relaxed);
+  }
+
+  MPMCQueue(const MPMCQueue &) = delete;
+  MPMCQueue &operator=(const MPMCQueue &) = delete;
+
+  ~MPMCQueue() {
+    // 析构时已经没有并发访问了，把剩下的元素析构掉
+    size_t tail = enqueue_pos_.load(std::memory_order_relaxed);
+    for (size_t pos = dequeue_pos_.load(std::memory_order_relaxed);
+         pos != tail; pos++) {
+      cells_[pos & mask_].ptr()->~T();
+    }
+    delete[] cells_;
+  }
+
+  inline size_t capacity() const { return mask_ + 1; }
+
+  // 只是一个近似值，并发时可能已经过时
+  inline size_t size() const {
+    size_t head = dequeue_pos_.load(std::memory_order_relaxed);
+    size_t tail = enqueue_pos_.load(std::memory_order_relaxed);
+    return tail > head ? tail - head : 0;
+  }
+
+  // 队列满时返回 false，不会抛异常
+  template <typename... Args> bool try_emplace(Args &&... args) {
+    size_t pos;
+    Cell_ *cell = claim_(enqueue_pos_, pos, 0);
+    if (cell == nullptr) {
+      return false;
+    }
+    new (cell->ptr()) T(std::forward<Args>(args)...);
+    cell->seq.store(pos + 1, std::memory_order_release);
+    return true;
+  }
+
+  inline bool try_push(const T &t) { return try_emplace(t); }
+  inline bool try_push(T &&t) { return try_emplace(std::move(t)); }
+
+  // 队列空时返回 false，否则把队头元素 move 到 t
+  bool try_pop(T &t) {
+    size_t pos;
+    Cell_ *cell = claim_(dequeue_pos_, pos, 1);
+    if (cell == nullptr) {
+      return false;
+    }
+    t = std::move(*cell->ptr());
+    cell->ptr()->~T();
+    cell->seq.store(pos + mask_ + 1, std::memory_order_release);
+    return true;
+  }
+
+  // 批量 push: 一次 CAS 占用连续的 k 个槽位，返回实际 push 的个数
+  // 成功 push 的元素会被 move 走
+  template <typename It> size_t try_push_n(It first, size_t n) {
+    size_t pos;
+    size_t k = claim_n_(enqueue_pos_, pos, 0, n);
+    for (size_t i = 0; i < k; i++, ++first) {
+      Cell_ &cell = cells_[(pos + i) & mask_];
+      new (cell.ptr()) T(std::move(*first));
+      cell.seq.store(pos + i + 1, std::memory_order_release);
+    }
+    return k;
+  }
+
+  // 批量 pop: 最多 pop n 个，依次 move 到 out，返回实际 pop 的个数
+  template <typename It> size_t try_pop_n(It out, size_t n) {
+    size_t pos;
+    size_t k = claim_n_(dequeue_pos_, pos, 1, n);
+    for (size_t i = 0; i < k; i++, ++out) {
+      Cell_ &cell = cells_[(pos + i) & mask_];
+      *out = std::move(*cell.ptr());
+      cell.ptr()->~T();
+      cell.seq.store(pos + i + mask_ + 1, std::memory_order_release);
+    }
+    return k;
+  }
+
+private:
+  struct Cell_ {
+    std::atomic<size_t> seq;
+    typename std::aligned_storage<sizeof(T), alignof(T)>::type storage;
+    inline T *ptr() { return reinterpret_cast<T *>(&storage); }
+  };
+
+  // 在 counter 上抢占一个位置，ready 为 0 表示生产者，1 表示消费者
+  // 抢不到(满或空)时返回 nullptr
+  inline Cell_ *claim_(std::atomic<size_t> &counter, size_t &pos,
+                       size_t ready) {
+    pos = counter.load(std::memory_order_relaxed);
+    while (true) {
+      Cell_ *cell = &cells_[pos & mask_];
+      size_t seq = cell->seq.load(std::memory_order_acquire);
+      intptr_t diff = (intptr_t)seq - (intptr_t)(pos + ready);
+      if (diff == 0) {
+        if (counter.compare_exchange_weak(pos, pos + 1,
+                                          std::memory_order_relaxed)) {
+          return cell;
+        }
+        // CAS 失败时 pos 已经被更新为最新值
+      } else if (diff < 0) {
+        return nullptr;
+      } else {
+        // 被别人抢先了
+        pos = counter.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  // 从 pos 开始数出连续就绪的槽位(最多 n 个)，一次 CAS 全部占用
+  inline size_t claim_n_(std::atomic<size_t> &counter, size_t &pos,
+                         size_t ready, size_t n) {
+    if (n == 0) {
+      return 0;
+    }
+    pos = counter.load(std::memory_order_relaxed);
+    while (true) {
+      size_t k = 0;
+      while (k < n) {
+        size_t seq = cells_[(pos + k) & mask_].seq.load(
+            std::memory_order_acquire);
+        if (seq != pos + k + ready) {
+          break;
+        }
+        k++;
+      }
+      if (k == 0) {
+        // 第一个槽位没有就绪：要么满/空，要么被别人抢先了
+        size_t seq = cells_[pos & mask_].seq.load(std::memory_order_acquire);
+        if ((intptr_t)seq - (intptr_t)(pos + ready) < 0) {
+          return 0;
+        }
+        pos = counter.load(std::memory_order_relaxed);
+        continue;
+      }
+      if (counter.compare_exchange_weak(pos, pos + k,
+                                        std::memory_order_relaxed)) {
+        return k;
+      }
+    }
+  }
+
+  Cell_ *cells_;
+  size_t mask_;
+  // 生产者和消费者的位置分别放在不同的 cache line 上
+  alignas(CLS) std::atomic<size_t> enqueue_pos_;
+  alignas(CLS) std::atomic<size_t> dequeue_pos_;
+};
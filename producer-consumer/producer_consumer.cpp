@@ -1,75 +1,76 @@
 
-#include "circular_buf.h"
-#include <mutex>
-#include <condition_variable>
+#include "blocking_queue.h"
+#include <algorithm>
+#include <cstdio>
 #include <thread>
 #include <chrono>
+#include <vector>
 
-std::mutex mu;
-std::condition_variable cv;
-
-void produce(CircularBuf<int> &buf, int producer_id, int product_id, size_t milli_sec = 10) {
-  std::unique_lock<std::mutex> ul(mu);
-  cv.wait(ul, [&]{
-    printf("Producer %d: buffer(at address %p) %zu / %zu\n",
-            producer_id, &buf, buf.size(), buf.capacity());
-    return !buf.full();
-  });
-  // not full
+// 生产/消费的耗时用 sleep 模拟，都在锁外面，不会挡住其他线程
+void produce(BlockingQueue<int> &queue, int producer_id, int product_id, size_t milli_sec = 10) {
   std::this_thread::sleep_for(std::chrono::milliseconds(milli_sec));
-  buf.push(product_id);
+  printf("Producer %d: queue(at address %p) %zu / %zu\n",
+          producer_id, &queue, queue.size(), queue.capacity());
+  queue.push(product_id);
   printf("Producer %d: produced %d...\n", producer_id, product_id);
-  ul.unlock();
-  cv.notify_one();
 }
 
-void consume(CircularBuf<int> &buf, int consumer_id, size_t milli_sec = 7) {
-  std::unique_lock<std::mutex> ul(mu);
-  cv.wait(ul, [&]{
-    printf("Consumer %d: buffer(at address %p) %zu / %zu \n",
-            consumer_id, &buf, buf.size(), buf.capacity());
-    return !buf.empty();
-  });
-  // not empty
+// 队列已关闭并且取完时返回 false
+bool consume(BlockingQueue<int> &queue, int consumer_id, size_t milli_sec = 7) {
+  int num;
+  if (!queue.pop(num)) {
+    return false;
+  }
   std::this_thread::sleep_for(std::chrono::milliseconds(milli_sec));
-  int num = buf.poll();
   printf("Consumer %d: consumed %d...\n", consumer_id, num);
-  ul.unlock();
-  cv.notify_one();
+  return true;
+}
+
+// 不分配内存，逐个打印缓冲区中的元素
+void printBuf(BlockingQueue<int> &queue) {
+  static std::mutex print_mu; // 避免多个线程的输出交错在一行里
+  std::lock_guard<std::mutex> lg(print_mu);
+  printf("Current buf: [");
+  queue.for_each([](int product) { printf(" %d", product); });
+  printf(" ]\n");
 }
 
 int main(int argc, char const *argv[]) {
-  CircularBuf<int> buf(5);
+  BlockingQueue<int> queue(5);
 
-  std::vector<std::thread> threads;
-  int n = std::thread::hardware_concurrency();
+  std::vector<std::thread> producers, consumers;
+  int n = std::max(2u, std::thread::hardware_concurrency());
   int product_num = 10;
   // half producer, half consumer
   for (int id = 0; id < n/2; id++) {
-    threads.push_back(std::thread([&](int producer_id){
+    producers.push_back(std::thread([&](int producer_id){
       // produce 10 products
       for (int i = 1; i <= product_num; i++) {
-        produce(buf, producer_id, 500 + i);
+        produce(queue, producer_id, 500 + i);
         printf("++++ Producer %d: produced %dth product\n", producer_id, i);
-        printf("Current buf: %s\n", buf.str().c_str());
+        printBuf(queue);
       }
       printf("**** Producer %d quit\n", producer_id);
     }, id));
 
-    threads.push_back(std::thread([&](int consumer_id){
-      // consume 10 products
-      for (int i = 1; i <= product_num; i++) {
-        consume(buf, consumer_id);
-        printf("---- Consumer %d: consumed %dth product\n", consumer_id, i);
-        printf("Current buf: %s\n", buf.str().c_str());
+    consumers.push_back(std::thread([&](int consumer_id){
+      // 一直消费，直到生产者都退出并且队列被取空
+      int i = 0;
+      while (consume(queue, consumer_id)) {
+        printf("---- Consumer %d: consumed %dth product\n", consumer_id, ++i);
+        printBuf(queue);
       }
       printf("**** Consumer %d quit.\n", consumer_id);
     }, id));
   }
 
-  printf("%lu threads created...\n", threads.size());
+  printf("%zu threads created...\n", producers.size() + consumers.size());
 
-  for (auto& thread : threads) {
+  for (auto& thread : producers) {
+    thread.join();
+  }
+  queue.close();
+  for (auto& thread : consumers) {
     thread.join();
   }
 
@@ -0,0 +1,546 @@
+// 把树里的几种队列放在同样的条件下比较，结果以 CSV 输出到 stdout:
+//   circularbuf+condvar  producer_consumer.cpp 原来的写法: CircularBuf + mutex + 一个条件变量
+//   blocking_queue       BlockingQueue，满/空两个条件变量
+//   mpmc_queue           无锁 MPMCQueue，满/空时自旋
+//   locked_ring          有锁的 RingBuffer (字节流)
+//   locked_ring_spin     同上，锁换成 ../sync 中的 SpinLock
+//   nolock_ring          无锁的 RingBuffer (字节流)，只支持 1 个生产者 1 个消费者
+//   threadpool           ThreadPool::AddJob，每个 job 处理一批消息
+//   threadpool_hybrid    同上，锁换成 ../sync 中的 HybridMutex
+//
+// 两类结果:
+//   throughput  生产者/消费者个数取 1, 2, 4 ... 直到核数，扫过不同的消息大小和批量大小，
+//               ops_per_sec 为每秒传递的消息数
+//   rtt         一个线程发消息，另一个线程原样发回，记录往返延迟的分位数，
+//               ops_per_sec 为每秒的往返次数
+//
+// 编译: make，然后 ./queue_bench [-o result.csv] [-n 每组的消息数] [--no-pin]
+// 结果写到 -o 指定的文件 (默认 queue_bench.csv)，同时打印到屏幕上
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <pthread.h>
+#include <sched.h>
+
+#include "../producer-consumer/blocking_queue.h"
+#include "../producer-consumer/circular_buf.h"
+#include "../producer-consumer/mpmc_queue.h"
+#include "../ring_buffer/no-lock/ringbuffer.h"
+#define RingBuffer LockedRingBuffer
+#include "../ring_buffer/with-lock/ringbuffer.h"
+#undef RingBuffer
+#include "../ThirdParty/threadpool/ThreadPool.h"
+#include "../sync/futex_mutex.h"
+#include "../sync/spinlock.h"
+
+const size_t QUEUE_MSGS = 1024; // 队列能放下的消息条数
+const size_t RTT_SAMPLES = 100000;
+
+size_t g_messages = 1000000; // 每组 throughput 传递的消息总数
+bool g_pin = true;
+int g_cores = 1;
+std::atomic<size_t> g_sink(0); // 防止消费者读消息的代码被优化掉
+FILE *g_out = nullptr;
+
+template <size_t N> struct Msg {
+  char data[N];
+};
+
+// 把线程绑到 cpu % 核数 上
+void pin(pthread_t thread, int cpu) {
+  if (!g_pin) {
+    return;
+  }
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(cpu % g_cores, &set);
+  pthread_setaffinity_np(thread, sizeof(set), &set);
+}
+
+inline void pinSelf(int cpu) { pin(pthread_self(), cpu); }
+
+// 自旋一段时间后让出 CPU，核数不够时不至于互相饿死
+inline void backoff(size_t &spins) {
+  if (++spins > 64) {
+    std::this_thread::yield();
+    spins = 0;
+  }
+}
+
+/*
+ * 每种队列包装成同样的接口:
+ *   send(msgs, n)    阻塞/自旋直到 n 条消息全部放入
+ *   recv(out, max)   阻塞/自旋直到至少收到一条，最多 max 条，关闭并且取空后返回 0
+ *   close()          生产者都结束之后调用
+ */
+
+// 单个条件变量，生产者和消费者都在上面等
+template <typename M> class CondvarQueue {
+public:
+  static const char *name() { return "circularbuf+condvar"; }
+  static bool supports(int, int) { return true; }
+
+  explicit CondvarQueue(size_t n) : buf_(n), closed_(false) {}
+
+  void send(const M *msgs, size_t n) {
+    for (size_t i = 0; i < n;) {
+      std::unique_lock<std::mutex> ul(mu_);
+      cv_.wait(ul, [&] { return !buf_.full(); });
+      for (; i < n && buf_.try_push(msgs[i]); i++) {
+      }
+      ul.unlock();
+      // 两边共用一个条件变量，notify_one 可能叫醒同一边的线程，
+      // 每边不止一个线程时会全部睡死，只能 notify_all
+      cv_.notify_all();
+    }
+  }
+
+  size_t recv(M *out, size_t max) {
+    std::unique_lock<std::mutex> ul(mu_);
+    cv_.wait(ul, [&] { return closed_ || !buf_.empty(); });
+    size_t k = 0;
+    for (; k < max && buf_.try_pop(out[k]); k++) {
+    }
+    ul.unlock();
+    cv_.notify_all();
+    return k;
+  }
+
+  void close() {
+    {
+      std::lock_guard<std::mutex> lg(mu_);
+      closed_ = true;
+    }
+    cv_.notify_all();
+  }
+
+private:
+  CircularBuf<M> buf_;
+  std::mutex mu_;
+  std::condition_variable cv_;
+  bool closed_;
+};
+
+template <typename M> class BlockingQueueAdapter {
+public:
+  static const char *name() { return "blocking_queue"; }
+  static bool supports(int, int) { return true; }
+
+  explicit BlockingQueueAdapter(size_t n) : queue_(n) {}
+  void send(const M *msgs, size_t n) { queue_.push_n(msgs, n); }
+  size_t recv(M *out, size_t max) { return queue_.pop_n(out, max); }
+  void close() { queue_.close(); }
+
+private:
+  BlockingQueue<M> queue_;
+};
+
+// 自旋的队列共用的关闭逻辑: 看到 closed_ 之后再取一次，
+// 生产者的写入都在 close() 之前，这一次一定能取到剩下的消息
+class SpinClose {
+public:
+  SpinClose() : closed_(false) {}
+  void close() { closed_.store(true, std::memory_order_release); }
+
+protected:
+  template <typename F> size_t spinRecv(F tryRecv) {
+    size_t spins = 0;
+    for (;;) {
+      size_t k = tryRecv();
+      if (k != 0) {
+        return k;
+      }
+      if (closed_.load(std::memory_order_acquire)) {
+        return tryRecv();
+      }
+      backoff(spins);
+    }
+  }
+
+  std::atomic<bool> closed_;
+};
+
+template <typename M> class MPMCAdapter : public SpinClose {
+public:
+  static const char *name() { return "mpmc_queue"; }
+  static bool supports(int, int) { return true; }
+
+  explicit MPMCAdapter(size_t n) : queue_(n) {}
+
+  void send(const M *msgs, size_t n) {
+    size_t spins = 0;
+    while (n != 0) {
+      size_t k = n == 1 ? queue_.try_push(*msgs) : queue_.try_push_n(msgs, n);
+      if (k == 0) backoff(spins);
+      msgs += k;
+      n -= k;
+    }
+  }
+
+  size_t recv(M *out, size_t max) {
+    return spinRecv([&]() -> size_t {
+      return max == 1 ? queue_.try_pop(*out) : queue_.try_pop_n(out, max);
+    });
+  }
+
+private:
+  MPMCQueue<M> queue_;
+};
+
+// 字节流的 ring: 每次读写都是消息大小的整数倍，容量也是，所以不会把一条消息拆开
+template <typename M, typename Ring> class ByteRingAdapter : public SpinClose {
+public:
+  explicit ByteRingAdapter(size_t n) : ring_(n * sizeof(M)) {}
+
+  void send(const M *msgs, size_t n) {
+    size_t spins = 0;
+    const char *data = reinterpret_cast<const char *>(msgs);
+    size_t len = n * sizeof(M);
+    while (len != 0) {
+      size_t k = ring_.putData(data, len);
+      if (k == 0) backoff(spins);
+      data += k;
+      len -= k;
+    }
+  }
+
+  size_t recv(M *out, size_t max) {
+    return spinRecv([&]() -> size_t {
+      return ring_.getData(reinterpret_cast<char *>(out), max * sizeof(M)) /
+             sizeof(M);
+    });
+  }
+
+protected:
+  Ring ring_;
+};
+
+template <typename M>
+class LockedRingAdapter : public ByteRingAdapter<M, LockedRingBuffer> {
+public:
+  static const char *name() { return "locked_ring"; }
+  // putData/getData 在锁外拷贝，只能有一个生产者和一个消费者
+  static bool supports(int producers, int consumers) {
+    return producers == 1 && consumers == 1;
+  }
+  explicit LockedRingAdapter(size_t n) : ByteRingAdapter<M, LockedRingBuffer>(n) {}
+};
+
+// 有锁的 RingBuffer 临界区只有几条指令，换成自旋锁
+template <typename M>
+class SpinRingAdapter
+    : public ByteRingAdapter<M, BasicRingBuffer<concurrency::SpinLock> > {
+public:
+  static const char *name() { return "locked_ring_spin"; }
+  static bool supports(int producers, int consumers) {
+    return producers == 1 && consumers == 1;
+  }
+  explicit SpinRingAdapter(size_t n)
+      : ByteRingAdapter<M, BasicRingBuffer<concurrency::SpinLock> >(n) {}
+};
+
+template <typename M>
+class NoLockRingAdapter : public ByteRingAdapter<M, RingBuffer> {
+public:
+  static const char *name() { return "nolock_ring"; }
+  static bool supports(int producers, int consumers) {
+    return producers == 1 && consumers == 1;
+  }
+  explicit NoLockRingAdapter(size_t n) : ByteRingAdapter<M, RingBuffer>(n) {
+    // 两边都在轮询，不会在 futex 上睡眠
+    this->ring_.setWaitStrategy(WaitStrategy::SpinYield);
+  }
+};
+
+/**********
+ * 统计 *
+ **********/
+struct Latency {
+  double p50, p99, p999, max;
+};
+
+Latency percentiles(std::vector<double> &samples) {
+  std::sort(samples.begin(), samples.end());
+  size_t n = samples.size();
+  Latency l = {samples[n / 2], samples[n * 99 / 100], samples[n * 999 / 1000],
+               samples.back()};
+  return l;
+}
+
+// 无锁 RingBuffer 的构造函数会往 stdout 打印，所以结果单独写一个文件
+void printRow(const char *row) {
+  fputs(row, g_out);
+  fflush(g_out);
+  fputs(row, stdout);
+  fflush(stdout);
+}
+
+void printHeader() {
+  printRow("kind,queue,producers,consumers,msg_size,batch,ops_per_sec,"
+           "p50_ns,p99_ns,p999_ns,max_ns\n");
+}
+
+void printThroughput(const char *queue, int producers, int consumers,
+                     size_t msg_size, size_t batch, double ops) {
+  char row[256];
+  snprintf(row, sizeof(row), "throughput,%s,%d,%d,%zu,%zu,%.0f,,,,\n", queue,
+           producers, consumers, msg_size, batch, ops);
+  printRow(row);
+}
+
+void printRtt(const char *queue, size_t msg_size, double ops, const Latency &l) {
+  char row[256];
+  snprintf(row, sizeof(row), "rtt,%s,1,1,%zu,1,%.0f,%.0f,%.0f,%.0f,%.0f\n",
+           queue, msg_size, ops, l.p50, l.p99, l.p999, l.max);
+  printRow(row);
+}
+
+/**********
+ * 测试 *
+ **********/
+// 所有线程就绪之后一起开始
+class StartGate {
+public:
+  StartGate() : go_(false) {}
+  void open() { go_.store(true, std::memory_order_release); }
+  void wait() {
+    while (!go_.load(std::memory_order_acquire)) {
+      std::this_thread::yield();
+    }
+  }
+
+private:
+  std::atomic<bool> go_;
+};
+
+// 第 id 个生产者负责的消息条数
+inline size_t share(size_t total, int workers, int id) {
+  return total / workers + (static_cast<size_t>(id) < total % workers ? 1 : 0);
+}
+
+template <typename Q, typename M>
+double throughput(int producers, int consumers, size_t batch) {
+  Q queue(QUEUE_MSGS);
+  StartGate gate;
+  std::vector<std::thread> ps, cs;
+  for (int id = 0; id < producers; id++) {
+    ps.push_back(std::thread([&, id]() {
+      pinSelf(id);
+      std::vector<M> msgs(batch);
+      for (size_t i = 0; i < batch; i++) {
+        memset(msgs[i].data, static_cast<int>(i), sizeof(msgs[i].data));
+      }
+      size_t total = share(g_messages, producers, id);
+      gate.wait();
+      for (size_t sent = 0; sent < total;) {
+        size_t n = std::min(batch, total - sent);
+        queue.send(msgs.data(), n);
+        sent += n;
+      }
+    }));
+  }
+  for (int id = 0; id < consumers; id++) {
+    cs.push_back(std::thread([&, id]() {
+      pinSelf(producers + id);
+      std::vector<M> out(batch);
+      size_t sink = 0;
+      gate.wait();
+      for (size_t k; (k = queue.recv(out.data(), batch)) != 0;) {
+        sink += out[k - 1].data[0];
+      }
+      g_sink += sink;
+    }));
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  gate.open();
+  for (auto &t : ps) {
+    t.join();
+  }
+  queue.close();
+  for (auto &t : cs) {
+    t.join();
+  }
+  std::chrono::duration<double> diff = std::chrono::steady_clock::now() - start;
+  return g_messages / diff.count();
+}
+
+template <typename Q, typename M> void rtt() {
+  Q ping(QUEUE_MSGS), pong(QUEUE_MSGS);
+  std::thread echo([&]() {
+    pinSelf(1);
+    M msg;
+    while (ping.recv(&msg, 1) != 0) {
+      pong.send(&msg, 1);
+    }
+  });
+  pinSelf(0);
+  M msg;
+  memset(msg.data, 0, sizeof(msg.data));
+  std::vector<double> samples(RTT_SAMPLES);
+  auto begin = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < RTT_SAMPLES; i++) {
+    auto start = std::chrono::steady_clock::now();
+    ping.send(&msg, 1);
+    pong.recv(&msg, 1);
+    samples[i] = std::chrono::duration<double, std::nano>(
+                     std::chrono::steady_clock::now() - start).count();
+  }
+  std::chrono::duration<double> diff = std::chrono::steady_clock::now() - begin;
+  ping.close();
+  echo.join();
+  printRtt(Q::name(), sizeof(M), RTT_SAMPLES / diff.count(), percentiles(samples));
+}
+
+// 生产者/消费者个数: 1, 2, 4 ... 最后一个是核数
+std::vector<int> threadCounts() {
+  std::vector<int> counts;
+  for (int n = 1; n < g_cores; n <<= 1) {
+    counts.push_back(n);
+  }
+  counts.push_back(std::max(1, g_cores));
+  return counts;
+}
+
+const size_t BATCHES[] = {1, 16};
+
+template <typename Q, typename M> void benchQueue() {
+  for (int producers : threadCounts()) {
+    for (int consumers : threadCounts()) {
+      if (!Q::supports(producers, consumers)) {
+        continue;
+      }
+      for (size_t batch : BATCHES) {
+        printThroughput(Q::name(), producers, consumers, sizeof(M), batch,
+                        throughput<Q, M>(producers, consumers, batch));
+      }
+    }
+  }
+  rtt<Q, M>();
+}
+
+// ThreadPool 的消费者是池里的线程，队列是无界的 std::queue<std::function>
+// 每个 job 捕获一批消息的拷贝
+template <typename Pool, typename M>
+double poolThroughput(int producers, int consumers, size_t batch) {
+  Pool pool(consumers);
+  for (int id = 0; id < consumers; id++) {
+    pin(pool.GetThreads()[id].native_handle(), producers + id);
+  }
+  StartGate gate;
+  std::vector<std::thread> ps;
+  for (int id = 0; id < producers; id++) {
+    ps.push_back(std::thread([&, id]() {
+      pinSelf(id);
+      size_t total = share(g_messages, producers, id);
+      gate.wait();
+      for (size_t sent = 0; sent < total;) {
+        size_t n = std::min(batch, total - sent);
+        std::vector<M> msgs(n);
+        pool.AddJob([msgs]() {
+          g_sink.fetch_add(msgs.back().data[0], std::memory_order_relaxed);
+        });
+        sent += n;
+      }
+    }));
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  gate.open();
+  for (auto &t : ps) {
+    t.join();
+  }
+  pool.WaitAll();
+  std::chrono::duration<double> diff = std::chrono::steady_clock::now() - start;
+  return g_messages / diff.count();
+}
+
+// 往返: 提交一个 job，等它在池里的线程上执行完
+template <typename Pool, typename M> void poolRtt(const char *name) {
+  Pool pool(1);
+  pin(pool.GetThreads()[0].native_handle(), 1);
+  pinSelf(0);
+  std::atomic<bool> done(false);
+  M msg;
+  memset(msg.data, 0, sizeof(msg.data));
+  std::vector<double> samples(RTT_SAMPLES);
+  auto begin = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < RTT_SAMPLES; i++) {
+    auto start = std::chrono::steady_clock::now();
+    done.store(false, std::memory_order_relaxed);
+    pool.AddJob([msg, &done]() { done.store(true, std::memory_order_release); });
+    size_t spins = 0;
+    while (!done.load(std::memory_order_acquire)) {
+      backoff(spins);
+    }
+    samples[i] = std::chrono::duration<double, std::nano>(
+                     std::chrono::steady_clock::now() - start).count();
+  }
+  std::chrono::duration<double> diff = std::chrono::steady_clock::now() - begin;
+  printRtt(name, sizeof(M), RTT_SAMPLES / diff.count(), percentiles(samples));
+}
+
+template <typename Pool, typename M> void benchPool(const char *name) {
+  for (int producers : threadCounts()) {
+    for (int consumers : threadCounts()) {
+      for (size_t batch : BATCHES) {
+        printThroughput(name, producers, consumers, sizeof(M), batch,
+                        poolThroughput<Pool, M>(producers, consumers, batch));
+      }
+    }
+  }
+  poolRtt<Pool, M>(name);
+}
+
+template <size_t N> void benchSize() {
+  typedef Msg<N> M;
+  benchQueue<CondvarQueue<M>, M>();
+  benchQueue<BlockingQueueAdapter<M>, M>();
+  benchQueue<MPMCAdapter<M>, M>();
+  benchQueue<LockedRingAdapter<M>, M>();
+  benchQueue<SpinRingAdapter<M>, M>();
+  benchQueue<NoLockRingAdapter<M>, M>();
+  benchPool<ThreadPool, M>("threadpool");
+  benchPool<BasicThreadPool<concurrency::HybridMutex>, M>("threadpool_hybrid");
+}
+
+int main(int argc, char const *argv[]) {
+  const char *path = "queue_bench.csv";
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--no-pin") == 0) {
+      g_pin = false;
+    } else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+      path = argv[++i];
+    } else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+      g_messages = strtoull(argv[++i], nullptr, 10);
+    } else {
+      g_messages = 0;
+      break;
+    }
+  }
+  if (g_messages == 0) {
+    fprintf(stderr, "usage: %s [-o result.csv] [-n messages] [--no-pin]\n", argv[0]);
+    return 1;
+  }
+  g_out = fopen(path, "w");
+  if (g_out == nullptr) {
+    perror(path);
+    return 1;
+  }
+  g_cores = std::max(1u, std::thread::hardware_concurrency());
+
+  printHeader();
+  benchSize<16>();
+  benchSize<64>();
+  benchSize<256>();
+  fclose(g_out);
+  return 0;
+}
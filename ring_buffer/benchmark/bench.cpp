@@ -0,0 +1,215 @@
+// 对比无锁 RingBuffer 与有锁 RingBuffer:
+//   1. 单生产者单消费者的吞吐 (messages/sec)，无锁版本分别测试 Heap 和 Mirrored 模式
+//   2. 两个 ring 之间 ping-pong 的往返延迟，以及不同等待策略下阻塞等待的往返延迟
+//   3. startWrite 后台线程落盘的带宽
+//   4. 后台线程落盘时生产者写小消息 (行情落盘的场景) 的耗时，以及整个进程的上下文切换次数
+// 编译: make，然后 ./ringbuf_bench
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+#include <sys/resource.h> // for getrusage()
+
+#include "../no-lock/ringbuffer.h"
+#define RingBuffer LockedRingBuffer
+#include "../with-lock/ringbuffer.h"
+#undef RingBuffer
+
+const size_t RING_SIZE = 1 << 16;
+const size_t MESSAGES = 2000000;
+const size_t PING_PONGS = 100000;
+
+// 自旋一段时间后让出 CPU，核数少于 2 时不至于互相饿死
+inline void backoff(size_t &spins) {
+  if (++spins > 256) {
+    std::this_thread::yield();
+    spins = 0;
+  }
+}
+
+// 轮询的一方不会在 futex 上睡眠，关掉 commit/release 中的唤醒检查
+inline void polling(RingBuffer &ring) {
+  ring.setWaitStrategy(WaitStrategy::SpinYield);
+}
+inline void polling(LockedRingBuffer &) {}
+
+// 字节流可能只写入/读出一部分，这里保证整条消息都被处理
+template <typename Ring> void putMessage(Ring &ring, const char *msg, size_t len) {
+  size_t spins = 0;
+  while (len != 0) {
+    size_t n = ring.putData(msg, len);
+    msg += n;
+    len -= n;
+    if (n == 0) backoff(spins);
+  }
+}
+
+template <typename Ring> void getMessage(Ring &ring, char *msg, size_t len) {
+  size_t spins = 0;
+  while (len != 0) {
+    size_t n = ring.getData(msg, len);
+    msg += n;
+    len -= n;
+    if (n == 0) backoff(spins);
+  }
+}
+
+template <typename Ring, typename... Args>
+void throughput(const char *name, size_t msg_size, Args... args) {
+  Ring ring(RING_SIZE, args...);
+  polling(ring);
+  std::vector<char> in(msg_size, 'x'), out(msg_size);
+
+  auto start = std::chrono::steady_clock::now();
+  std::thread producer([&]() {
+    for (size_t i = 0; i < MESSAGES; i++) {
+      putMessage(ring, in.data(), msg_size);
+    }
+  });
+  for (size_t i = 0; i < MESSAGES; i++) {
+    getMessage(ring, out.data(), msg_size);
+  }
+  producer.join();
+  auto end = std::chrono::steady_clock::now();
+
+  std::chrono::duration<double> diff = end - start;
+  printf("%-10s throughput: msg size %4zu, %12.0f msgs/sec, %8.1f MB/sec\n",
+         name, msg_size, MESSAGES / diff.count(),
+         MESSAGES * msg_size / diff.count() / (1 << 20));
+}
+
+template <typename Ring> void pingPong(const char *name) {
+  Ring ping(RING_SIZE), pong(RING_SIZE);
+  polling(ping);
+  polling(pong);
+  std::vector<double> rtts(PING_PONGS);
+
+  std::thread echo([&]() {
+    size_t msg;
+    for (size_t i = 0; i < PING_PONGS; i++) {
+      getMessage(ping, reinterpret_cast<char *>(&msg), sizeof(msg));
+      putMessage(pong, reinterpret_cast<char *>(&msg), sizeof(msg));
+    }
+  });
+  for (size_t i = 0; i < PING_PONGS; i++) {
+    size_t msg = i;
+    auto start = std::chrono::steady_clock::now();
+    putMessage(ping, reinterpret_cast<char *>(&msg), sizeof(msg));
+    getMessage(pong, reinterpret_cast<char *>(&msg), sizeof(msg));
+    auto end = std::chrono::steady_clock::now();
+    rtts[i] = std::chrono::duration<double, std::nano>(end - start).count();
+  }
+  echo.join();
+
+  std::sort(rtts.begin(), rtts.end());
+  printf("%-10s ping-pong RTT: p50 %8.0f ns, p99 %8.0f ns, max %10.0f ns\n",
+         name, rtts[PING_PONGS / 2], rtts[PING_PONGS * 99 / 100],
+         rtts.back());
+}
+
+// 用 waitData/waitSpace 阻塞等待而不是轮询，对比不同的等待策略
+void pingPongBlocking(const char *name, WaitStrategy strategy) {
+  RingBuffer ping(RING_SIZE), pong(RING_SIZE);
+  ping.setWaitStrategy(strategy);
+  pong.setWaitStrategy(strategy);
+  std::vector<double> rtts(PING_PONGS);
+
+  std::thread echo([&]() {
+    size_t msg;
+    for (size_t i = 0; i < PING_PONGS; i++) {
+      ping.waitData(sizeof(msg));
+      ping.getData(reinterpret_cast<char *>(&msg), sizeof(msg));
+      pong.putData(reinterpret_cast<char *>(&msg), sizeof(msg));
+    }
+  });
+  for (size_t i = 0; i < PING_PONGS; i++) {
+    size_t msg = i;
+    auto start = std::chrono::steady_clock::now();
+    ping.putData(reinterpret_cast<char *>(&msg), sizeof(msg));
+    pong.waitData(sizeof(msg));
+    pong.getData(reinterpret_cast<char *>(&msg), sizeof(msg));
+    auto end = std::chrono::steady_clock::now();
+    rtts[i] = std::chrono::duration<double, std::nano>(end - start).count();
+  }
+  echo.join();
+
+  std::sort(rtts.begin(), rtts.end());
+  printf("%-10s blocking RTT:  p50 %8.0f ns, p99 %8.0f ns, max %10.0f ns\n",
+         name, rtts[PING_PONGS / 2], rtts[PING_PONGS * 99 / 100],
+         rtts.back());
+}
+
+// 生产者全速写入，startWrite 的后台线程把数据落盘
+void drainThroughput(const char *path, size_t total) {
+  RingBuffer ring(1 << 22, RingMode::Mirrored);
+  std::vector<char> chunk(4096, 'x');
+  std::remove(path);
+
+  auto start = std::chrono::steady_clock::now();
+  ring.startWrite(path);
+  for (size_t written = 0; written < total; written += chunk.size()) {
+    ring.waitSpace(chunk.size());
+    ring.putData(chunk.data(), chunk.size());
+  }
+  ring.stopWrite();
+  auto end = std::chrono::steady_clock::now();
+
+  std::chrono::duration<double> diff = end - start;
+  printf("drain to %s: %zu MB in %.3f s, %8.1f MB/sec\n", path,
+         total >> 20, diff.count(), total / diff.count() / (1 << 20));
+  std::remove(path);
+}
+
+// 生产者一直写 64 字节的小消息，后台线程攒够半个缓冲区才落盘:
+// 生产者每条消息的耗时不应该包含唤醒后台线程的系统调用，上下文切换次数也应该远少于消息数
+void drainWithProducer(const char *path, size_t messages) {
+  RingBuffer ring(1 << 22, RingMode::Mirrored);
+  char msg[64] = {'x'};
+  std::vector<double> costs(messages);
+  std::remove(path);
+
+  struct rusage before, after;
+  getrusage(RUSAGE_SELF, &before);
+  auto start = std::chrono::steady_clock::now();
+  ring.startWrite(path);
+  for (size_t i = 0; i < messages; i++) {
+    auto t0 = std::chrono::steady_clock::now();
+    ring.waitSpace(sizeof(msg));
+    ring.putData(msg, sizeof(msg));
+    auto t1 = std::chrono::steady_clock::now();
+    costs[i] = std::chrono::duration<double, std::nano>(t1 - t0).count();
+  }
+  ring.stopWrite();
+  auto end = std::chrono::steady_clock::now();
+  getrusage(RUSAGE_SELF, &after);
+
+  std::chrono::duration<double> diff = end - start;
+  long switches = (after.ru_nvcsw - before.ru_nvcsw) + (after.ru_nivcsw - before.ru_nivcsw);
+  std::sort(costs.begin(), costs.end());
+  printf("drain with producer: %12.0f msgs/sec, put p50 %6.0f ns, p99 %8.0f ns, "
+         "%ld context switches\n",
+         messages / diff.count(), costs[messages / 2], costs[messages * 99 / 100], switches);
+  std::remove(path);
+}
+
+int main() {
+  const size_t sizes[] = {8, 64, 512};
+  for (size_t msg_size : sizes) {
+    throughput<RingBuffer>("no-lock", msg_size);
+    throughput<RingBuffer>("mirrored", msg_size, RingMode::Mirrored);
+    throughput<LockedRingBuffer>("with-lock", msg_size);
+  }
+  pingPong<RingBuffer>("no-lock");
+  pingPong<LockedRingBuffer>("with-lock");
+  // 只有一个核时 BusySpin 会一直占着 CPU 直到时间片用完
+  if (std::thread::hardware_concurrency() > 1) {
+    pingPongBlocking("busy-spin", WaitStrategy::BusySpin);
+  }
+  pingPongBlocking("spin-yield", WaitStrategy::SpinYield);
+  pingPongBlocking("futex", WaitStrategy::Futex);
+  drainThroughput("ringbuf_drain.bin", (size_t)1 << 30);
+  drainWithProducer("ringbuf_drain.bin", MESSAGES);
+  return 0;
+}
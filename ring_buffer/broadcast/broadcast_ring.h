@@ -0,0 +1,274 @@
+#pragma once
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <cstddef>
+#include <cstring>
+#include <type_traits>
+#include <vector>
+
+#include "../no-lock/wait_strategy.h"
+
+// L1d cache line 大小，可以用 getconf LEVEL1_DCACHE_LINESIZE 查询
+#ifndef CLS
+#define CLS 64
+#endif
+
+// 消费者跟不上时生产者的做法
+enum class OverflowPolicy {
+  Block,    // 等最慢的消费者，不丢数据
+  Overwrite // 直接覆盖，落后超过一圈的消费者跳过被覆盖的数据并记录丢失个数
+};
+
+// 一个生产者，多个消费者的广播 ring (disruptor 的做法)
+//
+// 生产者只写一次，每个消费者用自己的序号在原地读同一份数据，
+// N 个消费者只有一次拷贝。序号只增不减，slot = seq & mask。
+// 生产者: published_ 是下一个要写的序号，写完 slot 之后 release 发布
+// 消费者: 每个消费者一个 cursor (各自独占一个 cache line)，表示下一个要读的序号
+template <typename T> class BroadcastRing {
+public:
+  class Reader;
+
+  // 容量会向上取整到 2 的幂，max_readers 是最多能同时订阅的消费者个数
+  // Overwrite 模式下消费者可能读到正在被覆盖的数据，T 必须是 trivially copyable
+  BroadcastRing(size_t n, size_t max_readers,
+                OverflowPolicy policy = OverflowPolicy::Block)
+      : policy_(policy), strategy_(WaitStrategy::Futex),
+        cursors_(max_readers), published_(0), gate_(0) {
+    assert(policy == OverflowPolicy::Block ||
+           std::is_trivially_copyable<T>::value);
+    size_t size = 2;
+    while (size < n) {
+      size <<= 1;
+    }
+    mask_ = size - 1;
+    slots_ = std::vector<Slot_>(size);
+    gate_ = size;
+    for (auto &cursor : cursors_) {
+      cursor.seq.store(INACTIVE, std::memory_order_relaxed);
+    }
+  }
+
+  BroadcastRing(const BroadcastRing &) = delete;
+  BroadcastRing &operator=(const BroadcastRing &) = delete;
+
+  inline size_t capacity() const { return mask_ + 1; }
+  // 要在生产者和消费者开始之前设置
+  inline void setWaitStrategy(WaitStrategy strategy) { strategy_ = strategy; }
+
+  // 订阅之后从下一条发布的数据开始读，订阅满时返回的 Reader 无效
+  Reader subscribe() {
+    for (size_t i = 0; i < cursors_.size(); i++) {
+      size_t expected = INACTIVE;
+      // 先占住 cursor，再设置成当前的发布位置
+      // 占住期间生产者不会越过之前缓存的 gate_，不会覆盖起点之后的数据
+      if (cursors_[i].seq.compare_exchange_strong(expected, CLAIMING)) {
+        cursors_[i].seq.store(published_.load(std::memory_order_acquire),
+                              std::memory_order_release);
+        return Reader(this, i);
+      }
+    }
+    return Reader(nullptr, 0);
+  }
+
+  /**********
+  * 生产者 *
+  **********/
+  // 没有空间(Block 模式下最慢的消费者落后一整圈)时返回 false
+  bool tryPublish(const T &t) {
+    const size_t seq = published_.load(std::memory_order_relaxed);
+    if (policy_ == OverflowPolicy::Block && seq >= gate_) {
+      // 缓存的最慢消费者位置不够用了才去扫描所有消费者
+      gate_ = minCursor_(seq) + capacity();
+      if (seq >= gate_) {
+        return false;
+      }
+    }
+    Slot_ &slot = slots_[seq & mask_];
+    if (policy_ == OverflowPolicy::Overwrite) {
+      // 与 Reader::poll 中的检查配对: 消费者要么看到 BUSY，要么读到完整的数据
+      slot.seq.store(BUSY, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_release);
+      std::memcpy(static_cast<void *>(&slot.value), &t, sizeof(T));
+    } else {
+      slot.value = t;
+    }
+    slot.seq.store(seq, std::memory_order_release);
+    published_.store(seq + 1, std::memory_order_release);
+    if (strategy_ == WaitStrategy::Futex) {
+      data_ready_.notify();
+    }
+    return true;
+  }
+
+  // 阻塞直到有空间，超时返回 false
+  bool publish(const T &t, std::chrono::nanoseconds timeout =
+                               std::chrono::nanoseconds::max()) {
+    return space_ready_.wait(strategy_, [&]() { return tryPublish(t); },
+                             timeout);
+  }
+
+  // 发布过的数据总数
+  inline size_t published() const {
+    return published_.load(std::memory_order_acquire);
+  }
+
+  /**********
+  * 消费者 *
+  **********/
+  class Reader {
+  public:
+    Reader(Reader &&r) noexcept : ring_(r.ring_), index_(r.index_), lost_(r.lost_) {
+      r.ring_ = nullptr;
+    }
+    Reader(const Reader &) = delete;
+    Reader &operator=(const Reader &) = delete;
+    ~Reader() { unsubscribe(); }
+
+    inline bool valid() const { return ring_ != nullptr; }
+
+    // 取消订阅，之后不再拖慢生产者
+    void unsubscribe() {
+      if (ring_ != nullptr) {
+        ring_->cursors_[index_].seq.store(INACTIVE, std::memory_order_release);
+        ring_->notifySpace_();
+        ring_ = nullptr;
+      }
+    }
+
+    // 还没有读的数据个数
+    inline size_t available() const {
+      return ring_->published_.load(std::memory_order_acquire) - cursor_();
+    }
+
+    // 覆盖模式下因为落后太多而被跳过的数据个数
+    inline size_t lost() const { return lost_; }
+
+    // 等到有数据可读，超时返回 false
+    bool wait(std::chrono::nanoseconds timeout =
+                  std::chrono::nanoseconds::max()) {
+      return ring_->data_ready_.wait(ring_->strategy_,
+                                     [&]() { return available() != 0; },
+                                     timeout);
+    }
+
+    // 批量读出所有可读的数据(最多 max 个)，对每个调用 handler(const T&, size_t seq)
+    // Block 模式下 handler 拿到的是 ring 中的原始数据，没有拷贝
+    // 返回处理的个数
+    template <typename F>
+    size_t poll(F &&handler, size_t max = static_cast<size_t>(-1)) {
+      size_t seq = cursor_();
+      size_t end = ring_->published_.load(std::memory_order_acquire);
+      if (end - seq > max) {
+        end = seq + max;
+      }
+      size_t n = 0;
+      if (ring_->policy_ == OverflowPolicy::Block) {
+        for (; seq != end; seq++, n++) {
+          handler(ring_->slots_[seq & ring_->mask_].value, seq);
+        }
+      } else {
+        while (seq != end) {
+          if (end - seq > ring_->capacity()) {
+            // 已经落后超过一圈，跳到还没被覆盖的地方
+            size_t skip = end - seq - ring_->capacity();
+            lost_ += skip;
+            seq += skip;
+            continue;
+          }
+          T value;
+          if (!ring_->readSlot_(seq, value)) {
+            // 读的过程中被覆盖了，跳过它并重新计算落后了多少
+            lost_++;
+            seq++;
+            end = ring_->published_.load(std::memory_order_acquire);
+            continue;
+          }
+          handler(value, seq);
+          seq++;
+          n++;
+        }
+      }
+      // 整批读完再更新一次 cursor
+      ring_->cursors_[index_].seq.store(seq, std::memory_order_release);
+      ring_->notifySpace_();
+      return n;
+    }
+
+  private:
+    friend class BroadcastRing;
+    Reader(BroadcastRing *ring, size_t index)
+        : ring_(ring), index_(index), lost_(0) {}
+
+    inline size_t cursor_() const {
+      return ring_->cursors_[index_].seq.load(std::memory_order_relaxed);
+    }
+
+    BroadcastRing *ring_;
+    size_t index_;
+    size_t lost_;
+  };
+
+private:
+  static const size_t INACTIVE = static_cast<size_t>(-1);
+  static const size_t CLAIMING = static_cast<size_t>(-2);
+  static const size_t BUSY = static_cast<size_t>(-1);
+
+  struct Slot_ {
+    std::atomic<size_t> seq; // 最后写入这个 slot 的序号，正在写时为 BUSY
+    T value;
+    Slot_() : seq(BUSY), value() {}
+    Slot_(const Slot_ &s) : seq(s.seq.load()), value(s.value) {}
+  };
+
+  // 每个消费者的 cursor 独占一个 cache line
+  struct alignas(CLS) Cursor_ {
+    std::atomic<size_t> seq;
+  };
+
+  // 所有活跃消费者中最小的 cursor，没有消费者时返回 seq
+  size_t minCursor_(size_t seq) const {
+    size_t min = seq;
+    for (const auto &cursor : cursors_) {
+      size_t c = cursor.seq.load(std::memory_order_acquire);
+      if (c == CLAIMING) {
+        // 正在订阅，还不知道它的起点，先不要前进
+        return seq - capacity();
+      }
+      if (c != INACTIVE && c < min) {
+        min = c;
+      }
+    }
+    return min;
+  }
+
+  // 覆盖模式下读一个 slot，读的过程中被覆盖时返回 false (seqlock 的做法)
+  bool readSlot_(size_t seq, T &value) const {
+    const Slot_ &slot = slots_[seq & mask_];
+    if (slot.seq.load(std::memory_order_acquire) != seq) {
+      return false;
+    }
+    std::memcpy(static_cast<void *>(&value), &slot.value, sizeof(T));
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return slot.seq.load(std::memory_order_relaxed) == seq;
+  }
+
+  inline void notifySpace_() {
+    if (policy_ == OverflowPolicy::Block && strategy_ == WaitStrategy::Futex) {
+      space_ready_.notify();
+    }
+  }
+
+  OverflowPolicy policy_;
+  WaitStrategy strategy_;
+  size_t mask_;
+  std::vector<Slot_> slots_;
+  std::vector<Cursor_> cursors_;
+
+  // 生产者独占一个 cache line
+  alignas(CLS) std::atomic<size_t> published_;
+  size_t gate_; // 缓存的 最慢消费者位置 + 容量，seq 小于它时不用扫描消费者
+  Waiter data_ready_;  // 消费者在这里等数据
+  alignas(CLS) Waiter space_ready_; // 生产者在这里等最慢的消费者
+};
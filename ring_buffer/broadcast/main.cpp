@@ -0,0 +1,84 @@
+// 一个生产者把行情广播给三个消费者: 写文件、策略、监控
+// 1. Block 模式: 生产者等最慢的消费者，每个消费者都收到全部数据
+// 2. Overwrite 模式: 生产者从不等待，慢的监控会丢数据并统计丢失个数
+#include "broadcast_ring.h"
+#include <chrono>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+struct MarketData {
+  size_t seq;
+  double price;
+  int volume;
+  char symbol[8];
+};
+
+const size_t TICKS = 1000000;
+
+struct Stats {
+  size_t received;
+  size_t batches;
+  size_t checksum;
+};
+
+void run(OverflowPolicy policy, const char* name) {
+  BroadcastRing<MarketData> ring(4096, 3, policy);
+  const char* consumers[] = {"writer", "strategy", "monitor"};
+  std::vector<Stats> stats(3, Stats{0, 0, 0});
+
+  // 先订阅，再开始发布
+  std::vector<BroadcastRing<MarketData>::Reader> readers;
+  for (int i = 0; i < 3; i++) {
+    readers.push_back(ring.subscribe());
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  std::vector<std::thread> threads;
+  for (int i = 0; i < 3; i++) {
+    threads.push_back(std::thread([&, i]() {
+      auto& reader = readers[i];
+      Stats& s = stats[i];
+      while (s.received + reader.lost() < TICKS) {
+        if (!reader.wait(std::chrono::milliseconds(100))) {
+          continue;
+        }
+        // 一次把所有可读的数据处理完
+        s.received += reader.poll([&](const MarketData& md, size_t) {
+          s.checksum += md.seq;
+        });
+        s.batches++;
+        if (i == 2 && policy == OverflowPolicy::Overwrite) {
+          // 慢吞吞的监控
+          std::this_thread::sleep_for(std::chrono::microseconds(100));
+        }
+      }
+    }));
+  }
+
+  MarketData md = {0, 100.0, 1, "IF2312"};
+  for (size_t i = 0; i < TICKS; i++) {
+    md.seq = i;
+    md.price += 0.2;
+    ring.publish(md);
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  auto end = std::chrono::steady_clock::now();
+  std::chrono::duration<double> diff = end - start;
+
+  printf("%s: %zu ticks in %.3f s (%.0f ticks/sec)\n", name, TICKS,
+         diff.count(), TICKS / diff.count());
+  for (int i = 0; i < 3; i++) {
+    printf("\t%-8s received %7zu, lost %7zu, %6zu batches, checksum %s\n",
+           consumers[i], stats[i].received, readers[i].lost(), stats[i].batches,
+           stats[i].checksum == TICKS * (TICKS - 1) / 2 ? "ok" : "-");
+  }
+}
+
+int main() {
+  run(OverflowPolicy::Block, "Block");
+  run(OverflowPolicy::Overwrite, "Overwrite");
+  return 0;
+}
@@ -0,0 +1,91 @@
+#include "drainer.h"
+#include "ringbuffer.h"
+#include <cerrno>
+#include <cstdio>
+#include <cstring> // for strerror()
+#include <fcntl.h> // for open()
+#include <sys/uio.h> // for writev()
+#include <unistd.h> // for close()
+
+Drainer::Drainer(RingBuffer& ring, const std::string& path,
+                 size_t size_threshold, std::chrono::milliseconds max_latency)
+    : ring_(ring), path_(path), size_threshold_(size_threshold),
+      max_latency_(max_latency), fd_(-1), stop_(false), bytes_written_(0) {}
+
+Drainer::~Drainer() {
+  stop();
+}
+
+bool Drainer::start() {
+  if (fd_ != -1 || stop_.load(std::memory_order_relaxed)) {
+    // 已经启动，或者已经停止过
+    return fd_ != -1;
+  }
+  fd_ = open(path_.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+  if (fd_ == -1) {
+    printf("Open file %s failed.\n", path_.c_str());
+    return false;
+  }
+  thread_ = std::thread(&Drainer::run_, this);
+  return true;
+}
+
+void Drainer::stop() {
+  if (fd_ == -1) {
+    return;
+  }
+  stop_.store(true, std::memory_order_release);
+  // 只叫醒自己的线程，不关闭 ring: 关闭是永久的，生产者也会因此不再等待空间
+  ring_.wakeConsumer();
+  if (thread_.joinable()) {
+    thread_.join();
+  }
+  // 生产者已经停了，剩下的数据一次写完，出错就放弃
+  while (flush_() > 0) {
+  }
+  close(fd_);
+  fd_ = -1;
+}
+
+void Drainer::run_() {
+  bool failing = false;
+  while (!stop_.load(std::memory_order_acquire)) {
+    // 数据足够多，或者等够了 max_latency，都会写一次
+    ring_.waitData(size_threshold_, max_latency_, &stop_);
+    ssize_t n = flush_();
+    if (n == -1) {
+      // 磁盘满、fd 失效这类错误不会马上恢复: 只报告一次，隔 max_latency 再试
+      if (!failing) {
+        printf("Write file %s failed: %s, retry every %lld ms.\n", path_.c_str(),
+               strerror(errno), static_cast<long long>(max_latency_.count()));
+        failing = true;
+      }
+      ring_.waitData(static_cast<size_t>(-1), max_latency_, &stop_);
+    } else if (n > 0) {
+      failing = false;
+    }
+  }
+}
+
+ssize_t Drainer::flush_() {
+  RingRegion region = ring_.peek();
+  if (region.size() == 0) {
+    return 0;
+  }
+  struct iovec iov[2];
+  iov[0].iov_base = region.first.data;
+  iov[0].iov_len = region.first.len;
+  iov[1].iov_base = region.second.data;
+  iov[1].iov_len = region.second.len;
+  int iovcnt = region.second.len == 0 ? 1 : 2;
+
+  ssize_t n = writev(fd_, iov, iovcnt);
+  if (n == -1) {
+    // 被信号打断时下一次马上重试
+    return errno == EINTR ? 0 : -1;
+  }
+  // 部分写入时剩下的留到下一次
+  ring_.release(n);
+  bytes_written_.fetch_add(n, std::memory_order_relaxed);
+  return n;
+}
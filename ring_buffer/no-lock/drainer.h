@@ -0,0 +1,49 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <string>
+#include <thread>
+
+#include <sys/types.h> // for ssize_t
+
+class RingBuffer;
+
+// 后台线程，作为 RingBuffer 的消费者把数据写到文件
+// - 文件只打开一次，一直持有 fd
+// - 缓冲区中的数据(跨过末尾时是两段)用一次 writev 写出
+// - 可读数据达到 size_threshold，或者距离上次写入超过 max_latency 时才写，
+//   而不是每隔固定时间醒来一次
+// - stop() 之后把剩下的数据全部写完再关闭文件
+class Drainer {
+public:
+  Drainer(RingBuffer& ring, const std::string& path, size_t size_threshold,
+          std::chrono::milliseconds max_latency);
+  Drainer(const Drainer&) = delete;
+  Drainer& operator=(const Drainer&) = delete;
+  ~Drainer();
+
+  // 打开文件并启动线程，文件打开失败返回 false
+  bool start();
+  // 停止线程，写完剩下的数据并关闭文件；不会关闭 ring，之后可以换一个 Drainer 继续消费
+  // 同一个 Drainer 停止之后不能再 start()
+  void stop();
+
+  inline size_t bytesWritten() const {
+    return bytes_written_.load(std::memory_order_relaxed);
+  }
+
+private:
+  RingBuffer& ring_;
+  std::string path_;
+  size_t size_threshold_;
+  std::chrono::milliseconds max_latency_;
+  int fd_;
+  std::thread thread_;
+  std::atomic<bool> stop_;
+  std::atomic<size_t> bytes_written_;
+
+  void run_();
+  // 把当前所有可读数据写到文件，返回写入的字节数，出错时返回 -1
+  ssize_t flush_();
+};
@@ -1,11 +1,12 @@
 #include "ringbuffer.h"
+#include "record_ring.h"
 #include <thread>
 #include <random>
 #include <chrono>
 #include <cstddef>
 // #include <sstream>
 
-void putDataTo(RingBuffer* ringbuffer) {
+void putDataTo(RecordRing* ringbuffer) {
   std::default_random_engine dre(0);
   std::uniform_int_distribution<int> uid(10, 100);
   const std::string s = "Hello, SB.";
@@ -13,28 +14,29 @@ void putDataTo(RingBuffer* ringbuffer) {
   for (int i=0; i<1000; i++) {
     // ss << "Hello, SB.";
     // std::string s = ss.str();
-    ringbuffer->putData((char *)s.c_str(), s.size() + 1);
+    ringbuffer->waitSpace(s.size() + 1);
+    ringbuffer->putData(s.c_str(), s.size() + 1);
     // ss.clear();
     std::this_thread::sleep_for(std::chrono::milliseconds(uid(dre)));
   }
 }
 
-void getDataFrom(RingBuffer* ringbuffer) {
-  std::default_random_engine dre(1);
-  std::uniform_int_distribution<int> uid(50, 100);
-  for (int i=0; i<1000; i++) {
-    char buffer[20];
-    size_t before = ringbuffer->dataLength();
-    ringbuffer->getData(buffer, 11);
-    printf("Get(%d): %s, Size %lu -> %lu\n", i, buffer, before, ringbuffer->dataLength());
-    std::this_thread::sleep_for(std::chrono::milliseconds(uid(dre)));
+void getDataFrom(RecordRing* ringbuffer) {
+  for (int i=0; i<1000;) {
+    // 不再轮询，睡眠直到生产者写入一条完整的记录
+    ringbuffer->waitData();
+    // 一次取出所有完整的记录，不需要知道每条消息有多长
+    ringbuffer->drain([&](const char* data, size_t len) {
+      printf("Get(%d): %s, Size %lu\n", i++, data, len);
+    });
   }
 }
 
 int main() {
   RingBuffer ringbuf(4096);
-  std::thread t1(putDataTo, &ringbuf);
-  std::thread t2(getDataFrom, &ringbuf);
+  RecordRing records(ringbuf);
+  std::thread t1(putDataTo, &records);
+  std::thread t2(getDataFrom, &records);
   t1.join();
   t2.join();
   return 0;
@@ -0,0 +1,57 @@
+#include "record_ring.h"
+#include <cstring> // for memcpy
+
+bool RecordRing::putData(const char* data, size_t datalen) {
+  if (data == nullptr || datalen > maxRecordSize()) {
+    return false;
+  }
+  const size_t total = recordSize_(datalen);
+  RingRegion region = ring_.reserve(total);
+  if (region.size() < total) {
+    return false;
+  }
+  char* dest = region.first.data;
+  size_t padding = 0;
+  if (region.first.len < total) {
+    // 末尾放不下，先用一条填充记录占满末尾，真正的记录从头开始
+    padding = region.first.len;
+    region = ring_.reserve(padding + total);
+    if (region.size() < padding + total) {
+      return false;
+    }
+    Header_* pad = reinterpret_cast<Header_*>(region.first.data);
+    pad->len = padding - HEADER_SIZE;
+    pad->type = PADDING;
+    dest = region.second.data;
+  }
+  Header_* header = reinterpret_cast<Header_*>(dest);
+  header->len = datalen;
+  header->type = DATA;
+  memcpy(dest + HEADER_SIZE, data, datalen);
+  // 填充和记录一起发布，消费者看不到写了一半的记录
+  ring_.commit(padding + total);
+  return true;
+}
+
+bool RecordRing::getData(char* buf, size_t buflen, size_t* len) {
+  for (;;) {
+    RingRegion region = ring_.peek(HEADER_SIZE);
+    if (region.size() < HEADER_SIZE) {
+      *len = 0;
+      return false;
+    }
+    // 记录总是从 8 字节对齐的位置开始，头不会被分成两段
+    const Header_* header = reinterpret_cast<const Header_*>(region.first.data);
+    *len = header->len;
+    if (header->type == PADDING) {
+      ring_.release(recordSize_(*len));
+      continue;
+    }
+    if (*len > buflen) {
+      return false;
+    }
+    memcpy(buf, region.first.data + HEADER_SIZE, *len);
+    ring_.release(recordSize_(*len));
+    return true;
+  }
+}
@@ -0,0 +1,84 @@
+#pragma once
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+#include "ringbuffer.h"
+
+// 在 RingBuffer 上按记录读写，而不是按字节流
+//
+// 每条记录 = 8 字节的头(长度 + 类型) + 数据，整体按 8 字节对齐。
+// 写入是全有或全无的: 空间不够时什么都不写。
+// Heap 模式下记录不会跨过缓冲区末尾: 末尾剩下的空间放不下时写一条
+// 填充记录，真正的记录从头开始，所以消费者拿到的每条记录都是连续的。
+// 和 RingBuffer 一样只支持一个生产者一个消费者，
+// 并且这个 RingBuffer 不能再直接用 putData/getData 读写。
+class RecordRing {
+public:
+  explicit RecordRing(RingBuffer& ring) : ring_(ring) {}
+
+  // 一条记录最多能放多少字节的数据
+  inline size_t maxRecordSize() const {
+    return (ring_.capacity() >> 1) - HEADER_SIZE;
+  }
+
+  // 写入一条记录，空间不够或者记录太大时返回 false
+  bool putData(const char* data, size_t datalen);
+  // 读出一条记录，成功返回 true，*len 是记录的长度 (可以是 0)
+  // 失败返回 false，这条记录不会被读出: 没有记录时 *len 为 0；
+  // buflen 不够时 *len 是记录的长度，调用方可以换一个更大的 buf 再读
+  bool getData(char* buf, size_t buflen, size_t* len);
+
+  // 批量读出所有可读的记录(最多 max 条)，每条调用 visitor(const char* data, size_t len)
+  // data 直接指向缓冲区，visitor 返回之后就不能再用了，返回处理的记录条数
+  template <typename F>
+  size_t drain(F&& visitor, size_t max = static_cast<size_t>(-1)) {
+    RingRegion region = ring_.peek();
+    size_t consumed = 0, count = 0;
+    const RingSpan spans[] = {region.first, region.second};
+    for (const RingSpan& span : spans) {
+      size_t pos = 0;
+      while (count < max && pos + HEADER_SIZE <= span.len) {
+        const Header_* header = reinterpret_cast<const Header_*>(span.data + pos);
+        if (header->type == DATA) {
+          visitor(span.data + pos + HEADER_SIZE, static_cast<size_t>(header->len));
+          count++;
+        }
+        pos += recordSize_(header->len);
+        consumed += recordSize_(header->len);
+      }
+      if (pos != span.len) {
+        break;
+      }
+    }
+    // 整批处理完再还给生产者
+    ring_.release(consumed);
+    return count;
+  }
+
+  // 等到至少有一条记录可读
+  inline bool waitData(std::chrono::nanoseconds timeout = std::chrono::nanoseconds::max()) {
+    return ring_.waitData(HEADER_SIZE, timeout);
+  }
+  // 等到长度为 datalen 的记录一定能写入
+  inline bool waitSpace(size_t datalen,
+                        std::chrono::nanoseconds timeout = std::chrono::nanoseconds::max()) {
+    return ring_.waitSpace(recordSize_(datalen) << 1, timeout);
+  }
+
+private:
+  struct Header_ {
+    uint32_t len;  // 数据的长度，不含头和对齐
+    uint32_t type;
+  };
+  static const uint32_t DATA = 0;
+  static const uint32_t PADDING = 1;
+  static const size_t HEADER_SIZE = sizeof(Header_);
+  static const size_t ALIGN = 8;
+
+  static inline size_t recordSize_(size_t datalen) {
+    return (HEADER_SIZE + datalen + ALIGN - 1) & ~(ALIGN - 1);
+  }
+
+  RingBuffer& ring_;
+};
@@ -1,83 +1,364 @@
 #include "ringbuffer.h"
+#include "drainer.h"
 #include <assert.h>
+#include <cstdio>
+#include <cerrno>
 #include <cstring> // for memcpy
-#include <fstream>
-#include <chrono>
-#include <thread>
+#include <fcntl.h> // for O_* constants
+#include <new>
+#include <signal.h> // for kill()
+#include <sys/file.h> // for flock()
+#include <sys/mman.h> // for mmap(), memfd_create(), shm_open()
+#include <sys/stat.h> // for fstat()
+#include <unistd.h> // for ftruncate(), close()
 
-RingBuffer::RingBuffer() {
-  buffer_ = nullptr;
-  in_ = 0;
-  out_ = 0;
+// 把 fd 从 offset 开始的 size 字节连续映射两次
+// 返回的地址 p 和 p + size 指向同一块物理内存，失败时返回 nullptr
+static char* mapMirrored(int fd, off_t offset, size_t size) {
+  // 先占住 2 * size 的地址空间，再用 MAP_FIXED 覆盖成两份映射
+  void* addr = mmap(nullptr, size << 1, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (addr == MAP_FAILED) {
+    return nullptr;
+  }
+  char* base = static_cast<char*>(addr);
+  if (mmap(base, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, offset) == MAP_FAILED ||
+      mmap(base + size, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, offset) == MAP_FAILED) {
+    munmap(base, size << 1);
+    return nullptr;
+  }
+  return base;
 }
 
-RingBuffer::RingBuffer(size_t size): size_(size) {
-  assert(is_power_of_2_(size_));
-  buffer_ = new char[size];
-  in_ = 0;
-  out_ = 0;
+// Shared 模式共享内存的布局: 第一页是 Header_，之后是 size 字节的数据
+static const uint32_t SHM_MAGIC = 0x52494e47; // "RING"
+static const uint32_t SHM_VERSION = 2;
+
+RingBuffer::Header_::Header_(size_t size, bool shared)
+    : magic(0), version(SHM_VERSION), capacity(size), producer_pid(0),
+      consumer_pid(0), closed(false), in(0), out_cache(0), data_ready(shared),
+      out(0), in_cache(0), space_ready(shared) {}
+
+RingBuffer::RingBuffer()
+    : buffer_(nullptr), size_(0), mode_(RingMode::Heap), requested_mode_(RingMode::Heap),
+      strategy_(WaitStrategy::Futex), header_(&local_header_), role_(RingRole::Producer),
+      local_header_(0) {}
+
+RingBuffer::RingBuffer(size_t size, RingMode mode)
+    : buffer_(nullptr), size_(0), mode_(mode), requested_mode_(mode),
+      strategy_(WaitStrategy::Futex), header_(&local_header_), role_(RingRole::Producer),
+      local_header_(size) {
+  assert(mode != RingMode::Shared);
+  allocate_(size);
   printf("No lock ring buffer...\n" );
 }
 
-RingBuffer::~RingBuffer() {
-  if (buffer_) {
-    delete[] buffer_;
-    buffer_ = nullptr;
+RingBuffer::RingBuffer(const std::string& name, size_t size, RingRole role)
+    : buffer_(nullptr), size_(0), mode_(RingMode::Shared), requested_mode_(RingMode::Shared),
+      strategy_(WaitStrategy::Futex), header_(&local_header_), role_(role), local_header_(0) {
+  if (!openShared_(name, size)) {
+    printf("Open shared ring buffer %s failed.\n", name.c_str());
+    free_();
+    return;
   }
+  printf("Shared ring buffer %s: %s attached\n", name.c_str(),
+         role == RingRole::Producer ? "producer" : "consumer");
+}
+
+RingBuffer::~RingBuffer() {
+  stopWrite();
+  free_();
+}
+
+void RingBuffer::unlinkShared(const std::string& name) {
+  shm_unlink(name.c_str());
 }
 
 void RingBuffer::setSize(size_t size) {
+  assert(mode_ != RingMode::Shared);
+  free_();
+  allocate_(size);
+  reset_();
+}
+
+void RingBuffer::reset_() {
+  header_->capacity = size_;
+  header_->in.store(0, std::memory_order_relaxed);
+  header_->out.store(0, std::memory_order_relaxed);
+  header_->out_cache = header_->in_cache = 0;
+}
+
+void RingBuffer::allocate_(size_t size) {
   assert(is_power_of_2_(size));
-  if (buffer_) {
-    delete[] buffer_;
+  size_ = size;
+  // 上一次映射失败退回了 Heap，这一次仍然按用户要求的模式重新尝试
+  mode_ = requested_mode_;
+  if (mode_ == RingMode::Mirrored) {
+    assert(size % sysconf(_SC_PAGESIZE) == 0);
+    int fd = memfd_create("ringbuffer", MFD_CLOEXEC);
+    if (fd != -1 && ftruncate(fd, size) == 0) {
+      buffer_ = mapMirrored(fd, 0, size);
+    }
+    if (fd != -1) {
+      // 映射建立之后 fd 就不需要了
+      ::close(fd);
+    }
+    if (buffer_ != nullptr) {
+      return;
+    }
+    printf("Mirrored mapping failed, fall back to heap buffer.\n");
+    mode_ = RingMode::Heap;
   }
   buffer_ = new char[size];
+}
+
+void RingBuffer::free_() {
+  if (mode_ == RingMode::Shared) {
+    if (header_ != &local_header_) {
+      // 正常退出时让出自己的位置
+      int32_t pid = getpid();
+      if (role_ == RingRole::Producer) {
+        header_->producer_pid.compare_exchange_strong(pid, 0);
+      } else {
+        header_->consumer_pid.compare_exchange_strong(pid, 0);
+      }
+      munmap(header_, sysconf(_SC_PAGESIZE));
+      header_ = &local_header_;
+    }
+    if (buffer_ != nullptr) {
+      munmap(buffer_, size_ << 1);
+      buffer_ = nullptr;
+    }
+    return;
+  }
+  if (buffer_ == nullptr) {
+    return;
+  }
+  if (mode_ == RingMode::Mirrored) {
+    munmap(buffer_, size_ << 1);
+  } else {
+    delete[] buffer_;
+  }
+  buffer_ = nullptr;
+}
+
+// pid 对应的进程是否还活着
+static bool processAlive(int32_t pid) {
+  return pid != 0 && (kill(pid, 0) == 0 || errno == EPERM);
+}
+
+// 打开的共享内存文件，析构时放锁并关闭
+// flock 的锁属于打开的文件，mmap 也引用着它，光 close 不会放锁，要显式 LOCK_UN
+namespace {
+struct ShmFile_ {
+  int fd;
+  explicit ShmFile_(int f) : fd(f) {}
+  ~ShmFile_() {
+    flock(fd, LOCK_UN);
+    ::close(fd);
+  }
+};
+}
+
+bool RingBuffer::openShared_(const std::string& name, size_t size) {
+  const size_t page = sysconf(_SC_PAGESIZE);
+  assert(is_power_of_2_(size) && size % page == 0);
+  static_assert(sizeof(Header_) <= 4096, "Header_ must fit in one page.");
+
+  int fd = shm_open(name.c_str(), O_RDWR | O_CREAT, 0600);
+  if (fd == -1) {
+    return false;
+  }
+  // 谁先拿到文件锁、又发现还没有初始化 (没有 magic)，谁就初始化，不区分创建者和打开者。
+  // 初始化到一半的进程死掉时内核会释放它的锁，下一个进程会重新初始化，
+  // 不会留下一块永远没人初始化的共享内存
+  ShmFile_ file(fd);
+  if (flock(fd, LOCK_EX) != 0) {
+    return false;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    return false;
+  }
+  // 创建者可能死在 ftruncate 之前，这时文件太小，直接读 header 会 SIGBUS
+  bool sized = static_cast<size_t>(st.st_size) >= page;
+  if (!sized && ftruncate(fd, page + size) != 0) {
+    return false;
+  }
+
+  void* addr = mmap(nullptr, page, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (addr == MAP_FAILED) {
+    return false;
+  }
+  header_ = static_cast<Header_*>(addr);
+
+  if (!sized || __atomic_load_n(&header_->magic, __ATOMIC_ACQUIRE) != SHM_MAGIC) {
+    if (sized && static_cast<size_t>(st.st_size) != page + size &&
+        ftruncate(fd, page + size) != 0) {
+      return false;
+    }
+    new (header_) Header_(size, true);
+    // magic 最后写入，之后的进程看到 magic 时 header 已经初始化好了
+    __atomic_store_n(&header_->magic, SHM_MAGIC, __ATOMIC_RELEASE);
+  } else if (header_->version != SHM_VERSION || header_->capacity != size) {
+    printf("Shared ring buffer %s: version %u capacity %lu, expect version %u capacity %lu\n",
+           name.c_str(), header_->version, (unsigned long)header_->capacity,
+           SHM_VERSION, (unsigned long)size);
+    return false;
+  }
+
   size_ = size;
+  buffer_ = mapMirrored(fd, page, size);
+  if (buffer_ == nullptr) {
+    return false;
+  }
+
+  // 占住自己的位置；之前的进程已经退出时接管它
+  std::atomic<int32_t>& slot =
+      role_ == RingRole::Producer ? header_->producer_pid : header_->consumer_pid;
+  int32_t self = getpid();
+  int32_t owner = slot.load();
+  while (true) {
+    if (owner != 0 && processAlive(owner)) {
+      printf("Shared ring buffer %s: %s %d is still alive\n", name.c_str(),
+             role_ == RingRole::Producer ? "producer" : "consumer", owner);
+      return false;
+    }
+    if (slot.compare_exchange_strong(owner, self)) {
+      break;
+    }
+  }
+  // 崩溃的进程可能没来得及更新缓存或者还登记在 futex 上
+  // 已经 commit/release 的数据不会丢，没有 commit 的写入、没有 release 的读取会被丢弃/重读
+  if (role_ == RingRole::Producer) {
+    header_->out_cache = header_->out.load(std::memory_order_acquire);
+    header_->space_ready.reset();
+    // 上一个生产者关闭的 ring，新的生产者接着写
+    header_->closed.store(false, std::memory_order_release);
+  } else {
+    header_->in_cache = header_->in.load(std::memory_order_acquire);
+    header_->data_ready.reset();
+  }
+  return true;
 }
 
-void RingBuffer::putData(char* data, size_t datalen) {
-  if (data == nullptr || buffer_ == nullptr) return;
-  datalen = MIN(datalen, size_ - in_ + out_);
-  size_t len = MIN(datalen, size_ - (in_ & (size_ - 1)));
-  memcpy(buffer_ + (in_ & (size_-1)), data, len);
-  memcpy(buffer_, data + len, datalen - len);
-  in_ += datalen;
+bool RingBuffer::peerAlive() const {
+  if (mode_ != RingMode::Shared || header_ == &local_header_) {
+    return false;
+  }
+  return processAlive(role_ == RingRole::Producer ? header_->consumer_pid.load()
+                                                  : header_->producer_pid.load());
+}
+
+size_t RingBuffer::putData(const char* data, size_t datalen) {
+  if (data == nullptr || buffer_ == nullptr) return 0;
+  RingRegion region = reserve(datalen);
+  memcpy(region.first.data, data, region.first.len);
+  memcpy(region.second.data, data + region.first.len, region.second.len);
+  commit(region.size());
   // printf("PUT: \n\tpos in increase to %lu, out = %lu, data length = %lu(of %lu)\n", in_, out_, dataLength(), size_);
+  return region.size();
+}
+
+size_t RingBuffer::getData(char* buf, size_t datalen) {
+  if (buf == nullptr || buffer_ == nullptr) return 0;
+  RingRegion region = peek(datalen);
+  memcpy(buf, region.first.data, region.first.len);
+  memcpy(buf + region.first.len, region.second.data, region.second.len);
+  release(region.size());
+  return region.size();
 }
 
-void RingBuffer::getData(char* buf, size_t datalen) {
-  if (buf == nullptr || buffer_ == nullptr) return;
-  datalen = MIN(datalen, in_ - out_);
-  size_t len = MIN(datalen, size_ - (out_ & (size_ - 1)));
-  memcpy(buf, buffer_ + (out_ & (size_ - 1)), len);
-  memcpy(buf + len, buffer_, datalen - len);
-  out_ += datalen;
+RingRegion RingBuffer::reserve(size_t n) {
+  if (buffer_ == nullptr) {
+    RingRegion empty = {{nullptr, 0}, {nullptr, 0}};
+    return empty;
+  }
+  // in 只有自己会写，relaxed 即可
+  const size_t in = header_->in.load(std::memory_order_relaxed);
+  if (n > size_ - (in - header_->out_cache)) {
+    // 缓存的 out 显示空间不够，才去读消费者的 cache line
+    header_->out_cache = header_->out.load(std::memory_order_acquire);
+  }
+  return region_(in, MIN(n, size_ - (in - header_->out_cache)));
+}
+
+void RingBuffer::commit(size_t n) {
+  const size_t in = header_->in.load(std::memory_order_relaxed);
+  assert(n <= size_ - (in - header_->out_cache));
+  // release: 之前写入的数据一定在 in 更新之前对消费者可见
+  header_->in.store(in + n, std::memory_order_release);
+  if (strategy_ == WaitStrategy::Futex) {
+    // 消费者等的数据还没到齐时不叫醒它
+    header_->data_ready.notify(in + n);
+  }
+}
+
+RingRegion RingBuffer::peek(size_t n) {
+  if (buffer_ == nullptr) {
+    RingRegion empty = {{nullptr, 0}, {nullptr, 0}};
+    return empty;
+  }
+  const size_t out = header_->out.load(std::memory_order_relaxed);
+  if (n > header_->in_cache - out) {
+    header_->in_cache = header_->in.load(std::memory_order_acquire);
+  }
+  return region_(out, MIN(n, header_->in_cache - out));
+}
+
+void RingBuffer::release(size_t n) {
+  const size_t out = header_->out.load(std::memory_order_relaxed);
+  assert(n <= header_->in_cache - out);
+  // release: 读完之后才把空间还给生产者
+  header_->out.store(out + n, std::memory_order_release);
+  if (strategy_ == WaitStrategy::Futex) {
+    header_->space_ready.notify(out + n);
+  }
+}
+
+bool RingBuffer::waitData(size_t n, std::chrono::nanoseconds timeout,
+                          const std::atomic<bool>* cancel) {
+  const size_t out = header_->out.load(std::memory_order_relaxed);
+  // 生产者的 in 到达 out + n 才需要叫醒我们，n 很大时 (只等超时) 不要溢出
+  const size_t target = n > SIZE_MAX - out ? SIZE_MAX : out + n;
+  return header_->data_ready.wait(strategy_, [&]() {
+    header_->in_cache = header_->in.load(std::memory_order_acquire);
+    return header_->in_cache - out >= n || closed() ||
+           (cancel != nullptr && cancel->load(std::memory_order_acquire));
+  }, timeout, target) && header_->in_cache - out >= n;
+}
+
+bool RingBuffer::waitSpace(size_t n, std::chrono::nanoseconds timeout) {
+  const size_t in = header_->in.load(std::memory_order_relaxed);
+  // 消费者的 out 到达 in + n - size_ 才有 n 字节的空间
+  const size_t target = n > SIZE_MAX - in ? SIZE_MAX : in + n;
+  return header_->space_ready.wait(strategy_, [&]() {
+    header_->out_cache = header_->out.load(std::memory_order_acquire);
+    return size_ - (in - header_->out_cache) >= n || closed();
+  }, timeout, target < size_ ? 0 : target - size_) && size_ - (in - header_->out_cache) >= n;
+}
+
+void RingBuffer::close() {
+  header_->closed.store(true, std::memory_order_release);
+  header_->data_ready.notify();
+  header_->space_ready.notify();
 }
 
 // for xtp market data
 // 异步写文件
 void RingBuffer::startWrite(const std::string& path, size_t time_interval) {
-  auto f = [this](const std::string& path_, size_t time_interval_){
-    printf("Worker Thread: %08x\n", std::this_thread::get_id());
-    while (true) {
-      this->writeDataToFile(path_);
-      std::this_thread::sleep_for(std::chrono::seconds(time_interval_));
-    }
-  };
-  std::thread t(f, std::ref(path), time_interval);
-  t.detach();
+  if (drainer_) {
+    return;
+  }
+  drainer_.reset(new Drainer(*this, path, size_ >> 1,
+                             std::chrono::seconds(time_interval)));
+  if (!drainer_->start()) {
+    drainer_.reset();
+  }
 }
 
-void RingBuffer::writeDataToFile(const std::string& path) {
-  size_t size_to_write = in_ - out_;
-  std::ofstream fs(path, std::ios::out | std::ios::app);
-  if (fs.is_open() == false || size_to_write == 0) {
-    return;
+void RingBuffer::stopWrite() {
+  if (drainer_) {
+    drainer_->stop();
+    drainer_.reset();
   }
-  size_t len = MIN(size_to_write, size_ - (out_ & (size_ - 1)));
-  fs.write(buffer_ + (out_ & (size_ -1)), len);
-  fs.write(buffer_, size_to_write - len);
-  fs.close();
-  out_ += size_to_write;
-  // printf("GET: \n\tpos out increase to %lu, in = %lu, data length = %lu(of %lu)\n", out_, in_, dataLength(), size_);
 }
@@ -1,17 +1,68 @@
 #pragma once
+#include <atomic>
+#include <chrono>
 #include <cstddef>
+#include <cstdint>
+#include <memory>
 #include <string>
 
+#include "wait_strategy.h"
+
 #define MIN(A,B) ((A)<(B)?(A):(B))
 
+// L1d cache line 大小，可以用 getconf LEVEL1_DCACHE_LINESIZE 查询
+#ifndef CLS
+#define CLS 64
+#endif
+
+// 一段连续的内存
+struct RingSpan {
+  char *data;
+  size_t len;
+};
+
+// 缓冲区中的一段区域，跨过末尾时会被分成两段
+struct RingRegion {
+  RingSpan first;
+  RingSpan second;
+  inline size_t size() const { return first.len + second.len; }
+};
+
+// 缓冲区的内存来源
+enum class RingMode {
+  Heap,     // new char[size]，读写跨过末尾时分成两段
+  Mirrored, // 同一个 memfd 连续映射两次，任何区域在虚拟内存中都是连续的
+  Shared    // 放在 POSIX 共享内存中，同样是连续映射两次，用于进程间通信
+};
+
+// Shared 模式下当前进程的身份
+enum class RingRole {
+  Producer,
+  Consumer
+};
+
+class Drainer;
+
 class RingBuffer {
   // 1 个生产者，1 个消费者时不需要锁
+  // in 只由生产者修改，out 只由消费者修改：
+  // 生产者 memcpy 之后用 release 发布 in，消费者用 acquire 读 in，
+  // 保证看到新的 in 时数据已经写好；out 反过来同理。
 public:
   RingBuffer();
-  explicit RingBuffer(size_t size);
+  // Mirrored 模式下 size 还必须是页大小的整数倍，映射失败时退回 Heap 模式，
+  // 之后 setSize 仍然会先尝试 Mirrored
+  explicit RingBuffer(size_t size, RingMode mode = RingMode::Heap);
+  // 打开名为 name 的共享内存 ring，不存在时创建，size 要和创建者一致
+  // 每一方最多一个进程；之前占着这个位置的进程已经退出时会接管它的位置，
+  // 从上次 commit/release 的地方继续。失败时 valid() 返回 false
+  RingBuffer(const std::string& name, size_t size, RingRole role);
   ~RingBuffer();
 
-  inline size_t dataLength() {
+  // 删除共享内存的名字，已经打开的进程不受影响
+  static void unlinkShared(const std::string& name);
+
+  inline size_t dataLength() const {
     /*
        _____out______in_____
       |_空闲_|__占用__|_空闲_|   occupied = in - out
@@ -20,22 +71,102 @@ public:
       |_占用_|__空闲__|_占用_|   occupied = in + size - out
       由于是无符号类型, in < out 时会自动 wrap-around
     */
-    return in_ - out_;
+    // 先读 out 再读 in，保证结果不会"超过" size_
+    size_t out = header_->out.load(std::memory_order_acquire);
+    return header_->in.load(std::memory_order_acquire) - out;
   }
 
+  inline size_t capacity() const { return size_; }
+  // 实际使用的模式，Mirrored 映射失败时是 Heap
+  inline RingMode mode() const { return mode_; }
+  inline bool valid() const { return buffer_ != nullptr; }
+  // Shared 模式下对方进程是否还活着，对方还没有打开时返回 false
+  bool peerAlive() const;
+
+  // 不是线程安全的，只能在生产者和消费者都没有开始时调用
   void setSize(size_t size);
 
-  void putData(char* data, size_t datalen);
-  void getData(char* buf, size_t datalen);
+  // 返回实际写入/读出的字节数
+  size_t putData(const char* data, size_t datalen);
+  size_t getData(char* buf, size_t datalen);
+
+  // 零拷贝接口，直接在缓冲区内构造/解析数据
+  // 生产者: reserve 拿到最多 n 字节的可写区域，写好后 commit 实际写入的字节数
+  RingRegion reserve(size_t n);
+  void commit(size_t n);
+  // 消费者: peek 拿到最多 n 字节的可读区域，处理完后 release 已经用掉的字节数
+  RingRegion peek(size_t n = static_cast<size_t>(-1));
+  void release(size_t n);
+
+  // 阻塞等待，超时返回 false。默认使用 Futex 策略，
+  // 只有对方真的在睡眠，并且它等的字节数已经满足时，commit/release 才会进入内核唤醒它
+  // 策略要在生产者和消费者开始之前设置
+  inline void setWaitStrategy(WaitStrategy strategy) { strategy_ = strategy; }
+  // 消费者: 等到至少 n 字节可读
+  // cancel 不为空时，它变成 true 并且调用了 wakeConsumer() 也会返回，用于只停止消费者自己
+  bool waitData(size_t n, std::chrono::nanoseconds timeout = std::chrono::nanoseconds::max(),
+                const std::atomic<bool>* cancel = nullptr);
+  // 生产者: 等到至少 n 字节可写
+  bool waitSpace(size_t n, std::chrono::nanoseconds timeout = std::chrono::nanoseconds::max());
+  // 关闭之后 waitData/waitSpace 不再阻塞，条件不满足时直接返回 false
+  // 关闭是永久的 (Shared 模式下对其他进程也是)，只想叫醒消费者时用 wakeConsumer()
+  void close();
+  // 叫醒在 waitData 中睡眠的消费者，让它重新检查 cancel
+  inline void wakeConsumer() { header_->data_ready.notify(); }
+  inline bool closed() const { return header_->closed.load(std::memory_order_acquire); }
+
+  // for xtp market data
+  // 启动后台线程作为消费者把数据写到文件，可读数据超过一半缓冲区
+  // 或者等待超过 time_interval 秒就写一次
   void startWrite(const std::string& path, size_t time_interval = 1);
+  // 停止后台线程，剩下的数据写完后返回
+  void stopWrite();
 private:
+  // 生产者和消费者共享的状态，Shared 模式下放在共享内存的第一页
+  struct Header_ {
+    uint32_t magic;    // 初始化完成之后才写入
+    uint32_t version;  // 布局变化时递增
+    uint64_t capacity;
+    std::atomic<int32_t> producer_pid;
+    std::atomic<int32_t> consumer_pid;
+    std::atomic<bool> closed;
+
+    // 生产者独占一个 cache line: in 以及生产者看到的 out 的缓存
+    // 只有缓存的 out 显示空间不足时才去读真正的 out，减少跨核的 cache line 传递
+    alignas(CLS) std::atomic<size_t> in;
+    size_t out_cache;
+    Waiter data_ready; // 消费者在这里等数据
+
+    // 消费者独占一个 cache line
+    alignas(CLS) std::atomic<size_t> out;
+    size_t in_cache;
+    Waiter space_ready; // 生产者在这里等空间
+
+    explicit Header_(size_t size, bool shared = false);
+  };
+
   char *buffer_;
   size_t size_; // 缓冲区大小
-  size_t in_;
-  size_t out_;
+  RingMode mode_;           // 实际使用的模式
+  RingMode requested_mode_; // 构造时指定的模式，每次 setSize 都按它重新分配
+  WaitStrategy strategy_;
+  Header_ *header_; // 指向 local_header_ 或者共享内存
+  RingRole role_;   // 只对 Shared 模式有意义
+  std::unique_ptr<Drainer> drainer_;
+  Header_ local_header_;
 
   inline bool is_power_of_2_(size_t x) {
     return x != 0 && (x & (x-1)) == 0;
   }
-  void writeDataToFile(const std::string& path);
+  // 从 pos 开始的 n 字节区域，Mirrored/Shared 模式下第二段总是空的
+  inline RingRegion region_(size_t pos, size_t n) const {
+    size_t offset = pos & (size_ - 1);
+    size_t len = mode_ != RingMode::Heap ? n : MIN(n, size_ - offset);
+    RingRegion region = {{buffer_ + offset, len}, {buffer_, n - len}};
+    return region;
+  }
+  void allocate_(size_t size);
+  void free_();
+  bool openShared_(const std::string& name, size_t size);
+  void reset_();
 };
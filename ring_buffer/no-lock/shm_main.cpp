@@ -0,0 +1,56 @@
+// 两个进程通过共享内存中的 RingBuffer 通信
+//   ./shm_ringbuf producer    写入 1000 条消息
+//   ./shm_ringbuf consumer    读出 1000 条消息
+// 两个进程谁先启动都可以；任何一方崩溃后重新启动会从上次的位置继续
+#include "ringbuffer.h"
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+
+const char* SHM_NAME = "/ringbuf_demo";
+const size_t SHM_SIZE = 1 << 16;
+
+void produce(RingBuffer& ring) {
+  char msg[32];
+  for (int i = 0; i < 1000; i++) {
+    int len = snprintf(msg, sizeof(msg), "message %04d", i) + 1;
+    ring.waitSpace(len);
+    ring.putData(msg, len);
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+}
+
+void consume(RingBuffer& ring) {
+  const size_t len = strlen("message 0000") + 1;
+  for (int i = 0; i < 1000;) {
+    // 超时后检查一下生产者是否还活着
+    if (!ring.waitData(len, std::chrono::seconds(1))) {
+      printf("Waiting for data, producer %s\n", ring.peerAlive() ? "alive" : "gone");
+      continue;
+    }
+    char msg[32];
+    ring.getData(msg, len);
+    printf("Get(%d): %s\n", i++, msg);
+  }
+}
+
+int main(int argc, const char* argv[]) {
+  if (argc != 2 || (strcmp(argv[1], "producer") && strcmp(argv[1], "consumer"))) {
+    printf("Usage: %s producer|consumer\n", argv[0]);
+    return 0;
+  }
+  bool producer = strcmp(argv[1], "producer") == 0;
+  RingBuffer ring(SHM_NAME, SHM_SIZE, producer ? RingRole::Producer : RingRole::Consumer);
+  if (!ring.valid()) {
+    return -1;
+  }
+  if (producer) {
+    produce(ring);
+  } else {
+    consume(ring);
+    // 消费者读完后删除共享内存
+    RingBuffer::unlinkShared(SHM_NAME);
+  }
+  return 0;
+}
@@ -0,0 +1,142 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <thread>
+
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h> // for _mm_pause()
+#endif
+
+// 等待条件满足的方式
+enum class WaitStrategy {
+  BusySpin,  // 一直自旋，延迟最低，但要独占一个核
+  SpinYield, // 先自旋一会儿，之后每次检查前 yield 让出 CPU
+  Futex      // 先自旋一会儿，之后在 futex 上睡眠，由另一方唤醒
+};
+
+// 告诉 CPU 正在自旋: 降低功耗，让出超线程的执行资源，
+// 退出循环时也不会因为内存序推测失败而清空流水线
+inline void cpu_relax() {
+#if defined(__x86_64__) || defined(__i386__)
+  _mm_pause();
+#elif defined(__aarch64__)
+  asm volatile("yield" ::: "memory");
+#endif
+}
+
+// 一个等待点，比如 "有数据可读" 或 "有空间可写"
+// 等待方用 wait() 等 pred 成立，另一方让 pred 成立之后调用 notify()
+// 放在进程间共享内存中时 shared 要设为 true，否则 futex 只能唤醒本进程的线程
+//
+// 等待的条件是某个只增不减的位置 (比如 ring 的 in) 到达 target 时，等待方把 target 告诉 wait()，
+// 另一方用 notify(pos) 推进位置: 没有到达 target 就不进入内核，等一大块数据的消费者
+// 不会每来一条消息就被叫醒一次。一个 Waiter 同时只能有一个等待方 (单生产者单消费者)
+class Waiter {
+public:
+  explicit Waiter(bool shared = false)
+      : seq_(0), waiters_(0), private_(shared ? 0 : FUTEX_PRIVATE_FLAG), target_(0) {}
+
+  // 等待方崩溃时 waiters_ 可能永远不会减回去，接管它的位置时清零
+  inline void reset() {
+    waiters_.store(0, std::memory_order_relaxed);
+    target_.store(0, std::memory_order_relaxed);
+  }
+
+  // 只有确实有人在 futex 上睡眠时才会进入内核
+  // 调用之前 pred 依赖的状态必须已经发布
+  inline void notify() { notify(SIZE_MAX); }
+
+  // 位置推进到了 pos，只有等待方的 target 不超过 pos 时才叫醒它
+  inline void notify(size_t pos) {
+    // 与 wait() 中 fetch_add 之后的 fence 配对:
+    // 要么这里看到 waiters_ != 0，要么等待方在睡眠之前看到 pred 成立
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    // acquire: 看到了 fetch_add 就一定看到它之前写下的 target_
+    if (waiters_.load(std::memory_order_acquire) != 0 &&
+        pos >= target_.load(std::memory_order_relaxed)) {
+      seq_.fetch_add(1, std::memory_order_release);
+      futex_(FUTEX_WAKE | private_, INT_MAX, nullptr);
+    }
+  }
+
+  // 等到 pred() 为 true 返回 true，超时返回 false
+  // 只有 Futex 策略需要另一方调用 notify()；target 为 0 时任何 notify 都会叫醒等待方
+  template <typename Pred>
+  bool wait(WaitStrategy strategy, Pred pred,
+            std::chrono::nanoseconds timeout = std::chrono::nanoseconds::max(),
+            size_t target = 0) {
+    if (pred()) {
+      return true;
+    }
+    const auto deadline = timeout == std::chrono::nanoseconds::max()
+                              ? std::chrono::steady_clock::time_point::max()
+                              : std::chrono::steady_clock::now() + timeout;
+    for (size_t spins = 0;; spins++) {
+      if (pred()) {
+        return true;
+      }
+      if (strategy == WaitStrategy::BusySpin || spins < SPIN_LIMIT) {
+        cpu_relax();
+      } else if (strategy == WaitStrategy::SpinYield) {
+        std::this_thread::yield();
+      } else {
+        park_(pred, deadline, target);
+      }
+      // 自旋时每隔一段时间才检查一次时钟，yield/睡眠之后每次都检查
+      bool check = (spins & (SPIN_LIMIT - 1)) == 0 ||
+                   (strategy != WaitStrategy::BusySpin && spins >= SPIN_LIMIT);
+      if (check && deadline != std::chrono::steady_clock::time_point::max() &&
+          std::chrono::steady_clock::now() >= deadline) {
+        return pred();
+      }
+    }
+  }
+
+private:
+  static const size_t SPIN_LIMIT = 128;
+
+  template <typename Pred>
+  void park_(Pred &pred, std::chrono::steady_clock::time_point deadline, size_t target) {
+    target_.store(target, std::memory_order_relaxed);
+    waiters_.fetch_add(1, std::memory_order_seq_cst);
+    // 与 notify() 中的 fence 配对: 先登记再读 seq_ 和 pred 依赖的状态 (store -> load)，
+    // C++ 内存模型中只有两边都是 seq_cst fence 才能保证，不能只靠 x86 上 lock 前缀的效果
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    uint32_t seq = seq_.load(std::memory_order_acquire);
+    // 登记之后再检查一次，避免丢失唤醒
+    if (!pred()) {
+      if (deadline == std::chrono::steady_clock::time_point::max()) {
+        futex_(FUTEX_WAIT | private_, seq, nullptr);
+      } else {
+        auto left = deadline - std::chrono::steady_clock::now();
+        if (left > std::chrono::nanoseconds::zero()) {
+          auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(left);
+          timespec ts;
+          ts.tv_sec = ns.count() / 1000000000;
+          ts.tv_nsec = ns.count() % 1000000000;
+          futex_(FUTEX_WAIT | private_, seq, &ts);
+        }
+      }
+    }
+    waiters_.fetch_sub(1, std::memory_order_relaxed);
+  }
+
+  inline long futex_(int op, uint32_t val, const timespec *timeout) {
+    return syscall(SYS_futex, reinterpret_cast<uint32_t *>(&seq_), op, val,
+                   timeout, nullptr, 0);
+  }
+
+  // futex 只能等待 32 位的值
+  std::atomic<uint32_t> seq_;
+  std::atomic<uint32_t> waiters_;
+  int private_;
+  std::atomic<size_t> target_; // 睡眠中的等待方需要的位置
+};
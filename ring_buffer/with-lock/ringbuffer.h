@@ -1,13 +1,19 @@
 #pragma once
+#include <assert.h>
 #include <cstddef>
+#include <cstring> // for memcpy
 #include <mutex>
 
 #define MIN(A,B) ((A)<(B)?(A):(B))
 
-class RingBuffer {
+// Lock 保护 in_/out_，默认 std::mutex，也可以换成 ../../sync 中的锁:
+//   BasicRingBuffer<concurrency::SpinLock> ring(4096);
+// 临界区只有几条指令，自旋锁通常比 std::mutex 快
+template <typename Lock = std::mutex>
+class BasicRingBuffer {
 public:
-  explicit RingBuffer(size_t size);
-  ~RingBuffer();
+  explicit BasicRingBuffer(size_t size);
+  ~BasicRingBuffer();
 
   inline size_t dataLength() {
     /*
@@ -18,19 +24,20 @@ public:
       |_占用_|__空闲__|_占用_|   occupied = in + size - out
       由于是无符号类型, in < out 时会自动 wrap-around
     */
-    std::lock_guard<std::mutex> lg(mu_);
+    std::lock_guard<Lock> lg(mu_);
     return in_ - out_;
   }
 
-  void putData(char* data, size_t datalen);
-  void getData(char* buf, size_t datalen);
+  // 返回实际写入/读出的字节数
+  size_t putData(const char* data, size_t datalen);
+  size_t getData(char* buf, size_t datalen);
 
 private:
   char *buffer_;
   size_t size_; // 缓冲区大小
   size_t in_;
   size_t out_;
-  std::mutex mu_;
+  Lock mu_;
 
   inline bool is_power_of_2_(size_t x) {
     return x != 0 && (x & (x-1)) == 0;
@@ -45,7 +52,79 @@ private:
     |_占用_|__空闲__|_占用_|   free_size = out - in
   */
   // put data without lock
-  void copy_in_(char* data, size_t datalen, size_t in, size_t out);
+  void copy_in_(const char* data, size_t datalen, size_t in, size_t out);
   // get data without lock
   void copy_out_(char* buf, size_t datalen, size_t in, size_t out);
 };
+
+typedef BasicRingBuffer<> RingBuffer;
+
+template <typename Lock>
+BasicRingBuffer<Lock>::BasicRingBuffer(size_t size): size_(size) {
+  assert(is_power_of_2_(size_));
+  buffer_ = new char[size];
+  in_ = 0;
+  out_ = 0;
+}
+
+template <typename Lock>
+BasicRingBuffer<Lock>::~BasicRingBuffer() {
+  if (buffer_) {
+    delete[] buffer_;
+    buffer_ = nullptr;
+  }
+}
+
+template <typename Lock>
+void BasicRingBuffer<Lock>::copy_in_(const char* data, size_t datalen, size_t in, size_t out) {
+  size_t len = MIN(datalen, size_ - (in & (size_ - 1)));
+  memcpy(buffer_ + (in & (size_-1)), data, len);
+  memcpy(buffer_, data + len, datalen - len);
+}
+
+template <typename Lock>
+size_t BasicRingBuffer<Lock>::putData(const char* data, size_t datalen) {
+  if (data == nullptr || buffer_ == nullptr) return 0;
+  size_t in, out;
+  {
+    std::lock_guard<Lock> lg(mu_);
+    datalen = MIN(datalen, size_ - in_ + out_);
+    in = in_;
+    out = out_;
+  }
+  copy_in_(data, datalen, in, out);
+  {
+    std::lock_guard<Lock> lg(mu_);
+    in_ += datalen;
+  }
+  return datalen;
+}
+
+template <typename Lock>
+void BasicRingBuffer<Lock>::copy_out_(char* buf, size_t datalen, size_t in, size_t out) {
+  size_t len = MIN(datalen, size_ - (out & (size_ - 1)));
+  memcpy(buf, buffer_ + (out & (size_ - 1)), len);
+  memcpy(buf + len, buffer_, datalen - len);
+}
+
+template <typename Lock>
+size_t BasicRingBuffer<Lock>::getData(char* buf, size_t datalen) {
+  if (buf == nullptr || buffer_ == nullptr) return 0;
+  size_t in, out;
+  {
+    std::lock_guard<Lock> lg(mu_);
+    // 假设 in_ - out_ = 10，但是 datalen = 100，则只读出 10 个
+    datalen = MIN(datalen, in_ - out_);
+    in = in_;
+    out = out_;
+  }
+  copy_out_(buf, datalen, in, out);
+  {
+    std::lock_guard<Lock> lg(mu_);
+    out_ += datalen;
+  }
+  return datalen;
+}
+
+// 默认的 std::mutex 版本在 ringbuffer.cpp 中实例化
+extern template class BasicRingBuffer<std::mutex>;
@@ -9,6 +9,8 @@
 #include <mutex>
 #include <thread>
 
+#include "../sync/sharded_counter.h"
+
 // 需要能整除
 const int COUNTS = 100000;
 const int THREAD_NUM = 2;
@@ -110,9 +112,61 @@ void spinlock_add() {
             << " seconds" << std::endl;
 }
 
+// 每个线程加自己的分片，最后把所有分片加起来
+void sharded_add() {
+  concurrency::ShardedCounter<> total;
+  std::thread threads[THREAD_NUM];
+  int per_thread_count = COUNTS / THREAD_NUM;
+
+  auto start = std::chrono::steady_clock::now();
+
+  for (int i = 0; i < THREAD_NUM; i++) {
+    threads[i] = std::thread([&]() {
+      for (int j = 0; j < per_thread_count; j++) {
+        total.add(1);
+      }
+    });
+  }
+  for (int i = 0; i < THREAD_NUM; i++) {
+    threads[i].join();
+  }
+  auto end = std::chrono::steady_clock::now();
+  std::chrono::duration<double> diff = end - start;
+  std::cout << "sharded add: result = " << total.read() << ", time = " << diff.count()
+            << " seconds" << std::endl;
+}
+
+// 分片的最小值、最大值和总和
+void sharded_gauge() {
+  concurrency::ShardedGauge<> gauge;
+  std::thread threads[THREAD_NUM];
+  int per_thread_count = COUNTS / THREAD_NUM;
+
+  auto start = std::chrono::steady_clock::now();
+
+  for (int i = 0; i < THREAD_NUM; i++) {
+    threads[i] = std::thread([&, i]() {
+      for (int j = 0; j < per_thread_count; j++) {
+        gauge.record(i * per_thread_count + j);
+      }
+    });
+  }
+  for (int i = 0; i < THREAD_NUM; i++) {
+    threads[i].join();
+  }
+  auto end = std::chrono::steady_clock::now();
+  std::chrono::duration<double> diff = end - start;
+  concurrency::GaugeSnapshot s = gauge.read();
+  std::cout << "sharded gauge: count = " << s.count << ", sum = " << s.sum
+            << ", min = " << s.min << ", max = " << s.max << ", time = " << diff.count()
+            << " seconds" << std::endl;
+}
+
 int main(int argc, const char *argv[]) {
   unsafe_add();
   safe_add();
   atomic_add();
   spinlock_add();
+  sharded_add();
+  sharded_gauge();
 }
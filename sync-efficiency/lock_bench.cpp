@@ -0,0 +1,235 @@
+// 几种锁在不同线程数和临界区长度下的吞吐和公平性，结果以 CSV 输出:
+//   std::mutex, TAS/TTAS 自旋锁, ticket 锁, MCS/CLH 队列锁, futex 锁, 先自旋再 futex 的锁,
+//   std::shared_mutex (独占和共享两种用法)
+// 除了标准库的锁，都在 ../sync 中
+//
+// 每个线程反复: 拿锁，在临界区中修改 cs 个共享计数器，放锁，再做一点自己的事。
+// 每组跑固定的时间，统计每个线程完成的次数:
+//   ops_per_sec          所有线程每秒一共完成的次数
+//   jain                 Jain 公平性指数 (sum x)^2 / (n * sum x^2)，1 表示完全平均
+//   min_share/max_share  最少/最多的线程完成的次数除以平均值
+//
+// 编译: make，然后 ./lock_bench [-o result.csv] [-t 每组的毫秒数] [-c 最多线程数] [--no-pin]
+// 结果写到 -o 指定的文件 (默认 lock_bench.csv)，同时打印到屏幕上
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
+#include <vector>
+
+#include <pthread.h>
+#include <sched.h>
+
+#include "../sync/sync.h"
+
+using namespace concurrency;
+
+const size_t CS_LENGTHS[] = {1, 16, 128}; // 临界区中修改共享计数器的次数
+const size_t LOCAL_WORK = 64;             // 两次拿锁之间自己做的事
+const size_t COUNTERS = 8;                // 共享计数器都在一个缓存行里
+
+int g_millis = 200;
+int g_cores = 1;
+bool g_pin = true;
+FILE *g_out = nullptr;
+
+// 把线程绑到 cpu % 核数 上
+void pinSelf(int cpu) {
+  if (!g_pin) {
+    return;
+  }
+  int cores = std::thread::hardware_concurrency();
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(cpu % std::max(1, cores), &set);
+  pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+}
+
+// 不会被优化掉的空转
+inline void work(size_t n) {
+  for (size_t i = 0; i < n; i++) {
+    asm volatile("" ::: "memory");
+  }
+}
+
+/*************
+ * 共享锁 *
+ *************/
+// shared_mutex 只拿共享锁: 临界区只读，看读者之间是否还会互相影响
+class SharedMutexReader {
+public:
+  inline void lock() { mu_.lock_shared(); }
+  inline void unlock() { mu_.unlock_shared(); }
+
+private:
+  std::shared_mutex mu_;
+};
+
+template <typename Lock> struct IsReader { static const bool value = false; };
+template <> struct IsReader<SharedMutexReader> { static const bool value = true; };
+
+/*************
+ * 统计 *
+ *************/
+struct alignas(64) ThreadOps {
+  size_t ops;
+};
+
+struct alignas(64) SharedData {
+  size_t counters[COUNTERS];
+};
+
+void printRow(const char *row) {
+  fputs(row, g_out);
+  fflush(g_out);
+  fputs(row, stdout);
+  fflush(stdout);
+}
+
+void printResult(const char *lock, int threads, size_t cs, double secs,
+                 const std::vector<ThreadOps> &ops) {
+  double sum = 0, sumSq = 0;
+  size_t lo = ops[0].ops, hi = ops[0].ops;
+  for (const ThreadOps &t : ops) {
+    sum += t.ops;
+    sumSq += static_cast<double>(t.ops) * t.ops;
+    lo = std::min(lo, t.ops);
+    hi = std::max(hi, t.ops);
+  }
+  double mean = sum / threads;
+  char row[256];
+  snprintf(row, sizeof(row), "%s,%d,%zu,%.0f,%.3f,%.3f,%.3f\n", lock, threads, cs,
+           sum / secs, sumSq > 0 ? sum * sum / (threads * sumSq) : 0,
+           mean > 0 ? lo / mean : 0, mean > 0 ? hi / mean : 0);
+  printRow(row);
+}
+
+/*************
+ * 测试 *
+ *************/
+template <typename Lock> void run(const char *name, int threads, size_t cs) {
+  Lock lock;
+  SharedData shared;
+  memset(&shared, 0, sizeof(shared));
+  std::vector<ThreadOps> ops(threads);
+  std::atomic<int> ready(0);
+  std::atomic<bool> go(false), stop(false);
+
+  std::vector<std::thread> workers;
+  for (int id = 0; id < threads; id++) {
+    workers.push_back(std::thread([&, id]() {
+      pinSelf(id);
+      size_t n = 0, sink = 0;
+      ready.fetch_add(1);
+      while (!go.load(std::memory_order_acquire)) {
+        std::this_thread::yield();
+      }
+      while (!stop.load(std::memory_order_relaxed)) {
+        lock.lock();
+        if (IsReader<Lock>::value) {
+          for (size_t k = 0; k < cs; k++) {
+            sink += shared.counters[k % COUNTERS];
+          }
+        } else {
+          for (size_t k = 0; k < cs; k++) {
+            shared.counters[k % COUNTERS]++;
+          }
+        }
+        lock.unlock();
+        n++;
+        work(LOCAL_WORK);
+      }
+      ops[id].ops = n;
+      asm volatile("" : : "r"(sink)); // 让只读的临界区不被优化掉
+    }));
+  }
+  while (ready.load() != threads) {
+    std::this_thread::yield();
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  go.store(true, std::memory_order_release);
+  std::this_thread::sleep_for(std::chrono::milliseconds(g_millis));
+  stop.store(true);
+  for (auto &t : workers) {
+    t.join();
+  }
+  std::chrono::duration<double> diff = std::chrono::steady_clock::now() - start;
+
+  if (!IsReader<Lock>::value) {
+    size_t total = 0, expect = 0;
+    for (size_t c : shared.counters) {
+      total += c;
+    }
+    for (const ThreadOps &t : ops) {
+      expect += t.ops * cs;
+    }
+    if (total != expect) {
+      fprintf(stderr, "%s: lost updates, %zu != %zu\n", name, total, expect);
+      exit(1);
+    }
+  }
+  printResult(name, threads, cs, diff.count(), ops);
+}
+
+// 线程数: 1, 2, 4 ... 最后一个是核数
+std::vector<int> threadCounts() {
+  std::vector<int> counts;
+  for (int n = 1; n < g_cores; n <<= 1) {
+    counts.push_back(n);
+  }
+  counts.push_back(std::max(1, g_cores));
+  return counts;
+}
+
+template <typename Lock> void bench(const char *name) {
+  for (size_t cs : CS_LENGTHS) {
+    for (int threads : threadCounts()) {
+      run<Lock>(name, threads, cs);
+    }
+  }
+}
+
+int main(int argc, char const *argv[]) {
+  const char *path = "lock_bench.csv";
+  g_cores = std::max(1u, std::thread::hardware_concurrency());
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--no-pin") == 0) {
+      g_pin = false;
+    } else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+      path = argv[++i];
+    } else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+      g_millis = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "-c") == 0 && i + 1 < argc) {
+      g_cores = std::max(1, atoi(argv[++i]));
+    } else {
+      fprintf(stderr, "usage: %s [-o result.csv] [-t millis] [-c max threads] [--no-pin]\n",
+              argv[0]);
+      return 1;
+    }
+  }
+  g_out = fopen(path, "w");
+  if (g_out == nullptr) {
+    perror(path);
+    return 1;
+  }
+
+  printRow("lock,threads,cs,ops_per_sec,jain,min_share,max_share\n");
+  bench<std::mutex>("std_mutex");
+  bench<TASLock>("tas_backoff");
+  bench<TTASLock>("ttas_backoff");
+  bench<TicketLock>("ticket");
+  bench<MCSLock>("mcs");
+  bench<CLHLock>("clh");
+  bench<FutexMutex>("futex_mutex");
+  bench<HybridMutex>("hybrid_mutex");
+  bench<std::shared_mutex>("shared_mutex");
+  bench<SharedMutexReader>("shared_mutex_read");
+  fclose(g_out);
+  return 0;
+}
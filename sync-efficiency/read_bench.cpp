@@ -0,0 +1,284 @@
+// 读多写少的数据，读者越来越多时每秒能读多少次，结果以 CSV 输出:
+//   std::mutex, SpinLock, std::shared_mutex (读者拿共享锁), SeqLock, RcuPtr
+// 后两个在 ../sync 中
+//
+// 一个写者每隔 -w 微秒把整个快照改写一次 (所有字段都改成新的版本号)，
+// 其余线程不停地读，读到的字段不一致就说明读到了写了一半的数据，直接退出。
+// 快照有两种大小: 4 个 8 字节 (一条报价) 和 64 个 8 字节 (一小张表)
+//   reads_per_sec  所有读者每秒一共读完的次数
+//   per_reader     平均每个读者每秒读完的次数，随读者数不变说明读者之间互不影响
+//   writes         这一组写者一共写了几次
+//
+// 编译: make，然后 ./read_bench [-o result.csv] [-t 每组的毫秒数] [-c 最多读者数] [-w 写间隔微秒] [--no-pin]
+// 结果写到 -o 指定的文件 (默认 read_bench.csv)，同时打印到屏幕上
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
+#include <vector>
+
+#include <pthread.h>
+#include <sched.h>
+
+#include "../sync/rcu.h"
+#include "../sync/seqlock.h"
+#include "../sync/spinlock.h"
+
+using namespace concurrency;
+
+int g_millis = 200;
+int g_cores = 1;
+int g_writeMicros = 100;
+bool g_pin = true;
+FILE *g_out = nullptr;
+
+// 把线程绑到 cpu % 核数 上
+void pinSelf(int cpu) {
+  if (!g_pin) {
+    return;
+  }
+  int cores = std::thread::hardware_concurrency();
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(cpu % std::max(1, cores), &set);
+  pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+}
+
+void printRow(const char *row) {
+  fputs(row, g_out);
+  fflush(g_out);
+  fputs(row, stdout);
+  fflush(stdout);
+}
+
+/*************
+ * 快照 *
+ *************/
+template <size_t N> struct Snapshot {
+  uint64_t fields[N];
+
+  void fill(uint64_t version) {
+    for (uint64_t &f : fields) {
+      f = version;
+    }
+  }
+  // 所有字段是同一个版本，返回版本号
+  uint64_t check() const {
+    for (uint64_t f : fields) {
+      if (f != fields[0]) {
+        fprintf(stderr, "torn read: %lu != %lu\n", (unsigned long)f, (unsigned long)fields[0]);
+        exit(1);
+      }
+    }
+    return fields[0];
+  }
+};
+
+/*************
+ * 几种发布方式 *
+ *************/
+// 读写都拿同一把锁，读完拷贝出来
+template <typename Lock, typename Snap> class Locked {
+public:
+  Locked() { snap_.fill(0); }
+  uint64_t read() {
+    std::lock_guard<Lock> lg(lock_);
+    return snap_.check();
+  }
+  void write(uint64_t version) {
+    std::lock_guard<Lock> lg(lock_);
+    snap_.fill(version);
+  }
+
+private:
+  Lock lock_;
+  Snap snap_;
+};
+
+template <typename Snap> class SharedLocked {
+public:
+  SharedLocked() { snap_.fill(0); }
+  uint64_t read() {
+    std::shared_lock<std::shared_mutex> lg(lock_);
+    return snap_.check();
+  }
+  void write(uint64_t version) {
+    std::lock_guard<std::shared_mutex> lg(lock_);
+    snap_.fill(version);
+  }
+
+private:
+  std::shared_mutex lock_;
+  Snap snap_;
+};
+
+template <typename Snap> class SeqLocked {
+public:
+  uint64_t read() { return seq_.load().check(); }
+  void write(uint64_t version) {
+    Snap snap;
+    snap.fill(version);
+    seq_.store(snap);
+  }
+
+private:
+  SeqLock<Snap> seq_;
+};
+
+template <typename Snap> class Rcu {
+public:
+  Rcu() : ptr_(newSnap_(0)) {}
+  uint64_t read() {
+    RcuReadLock guard;
+    return ptr_.read()->check();
+  }
+  void write(uint64_t version) { ptr_.update(newSnap_(version)); }
+
+private:
+  RcuPtr<Snap> ptr_;
+
+  static Snap *newSnap_(uint64_t version) {
+    Snap *snap = new Snap;
+    snap->fill(version);
+    return snap;
+  }
+};
+
+/*************
+ * 测试 *
+ *************/
+struct alignas(64) ThreadOps {
+  size_t ops;
+};
+
+template <typename Method> void run(const char *name, size_t fields, int readers) {
+  Method method;
+  std::vector<ThreadOps> ops(readers);
+  std::atomic<int> ready(0);
+  std::atomic<bool> go(false), stop(false);
+
+  std::vector<std::thread> workers;
+  for (int id = 0; id < readers; id++) {
+    workers.push_back(std::thread([&, id]() {
+      pinSelf(id);
+      size_t n = 0;
+      uint64_t last = 0;
+      ready.fetch_add(1);
+      while (!go.load(std::memory_order_acquire)) {
+        std::this_thread::yield();
+      }
+      while (!stop.load(std::memory_order_relaxed)) {
+        uint64_t version = method.read();
+        if (version < last) {
+          fprintf(stderr, "%s: version went back from %lu to %lu\n", name,
+                  (unsigned long)last, (unsigned long)version);
+          exit(1);
+        }
+        last = version;
+        n++;
+      }
+      ops[id].ops = n;
+    }));
+  }
+  while (ready.load() != readers) {
+    std::this_thread::yield();
+  }
+
+  // 写者和最后一个读者挤在同一个核上
+  uint64_t writes = 0;
+  std::thread writer([&]() {
+    pinSelf(readers - 1);
+    while (!go.load(std::memory_order_acquire)) {
+      std::this_thread::yield();
+    }
+    while (!stop.load(std::memory_order_relaxed)) {
+      method.write(++writes);
+      std::this_thread::sleep_for(std::chrono::microseconds(g_writeMicros));
+    }
+  });
+
+  auto start = std::chrono::steady_clock::now();
+  go.store(true, std::memory_order_release);
+  std::this_thread::sleep_for(std::chrono::milliseconds(g_millis));
+  stop.store(true);
+  for (auto &t : workers) {
+    t.join();
+  }
+  writer.join();
+  std::chrono::duration<double> diff = std::chrono::steady_clock::now() - start;
+
+  double sum = 0;
+  for (const ThreadOps &t : ops) {
+    sum += t.ops;
+  }
+  char row[256];
+  snprintf(row, sizeof(row), "%s,%zu,%d,%.0f,%.0f,%lu\n", name, fields * sizeof(uint64_t),
+           readers, sum / diff.count(), sum / diff.count() / readers, (unsigned long)writes);
+  printRow(row);
+}
+
+// 读者数: 1, 2, 4 ... 最后一个是核数
+std::vector<int> readerCounts() {
+  std::vector<int> counts;
+  for (int n = 1; n < g_cores; n <<= 1) {
+    counts.push_back(n);
+  }
+  counts.push_back(std::max(1, g_cores));
+  return counts;
+}
+
+template <typename Method> void bench(const char *name, size_t fields) {
+  for (int readers : readerCounts()) {
+    run<Method>(name, fields, readers);
+  }
+}
+
+template <size_t N> void benchAll() {
+  typedef Snapshot<N> Snap;
+  bench<Locked<std::mutex, Snap> >("std_mutex", N);
+  bench<Locked<SpinLock, Snap> >("spinlock", N);
+  bench<SharedLocked<Snap> >("shared_mutex", N);
+  bench<SeqLocked<Snap> >("seqlock", N);
+  bench<Rcu<Snap> >("rcu", N);
+}
+
+int main(int argc, char const *argv[]) {
+  const char *path = "read_bench.csv";
+  g_cores = std::max(1u, std::thread::hardware_concurrency());
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--no-pin") == 0) {
+      g_pin = false;
+    } else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+      path = argv[++i];
+    } else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+      g_millis = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "-c") == 0 && i + 1 < argc) {
+      g_cores = std::max(1, atoi(argv[++i]));
+    } else if (strcmp(argv[i], "-w") == 0 && i + 1 < argc) {
+      g_writeMicros = std::max(0, atoi(argv[++i]));
+    } else {
+      fprintf(stderr,
+              "usage: %s [-o result.csv] [-t millis] [-c max readers] [-w write interval us] "
+              "[--no-pin]\n",
+              argv[0]);
+      return 1;
+    }
+  }
+  g_out = fopen(path, "w");
+  if (g_out == nullptr) {
+    perror(path);
+    return 1;
+  }
+
+  printRow("method,bytes,readers,reads_per_sec,per_reader,writes\n");
+  benchAll<4>();
+  benchAll<64>();
+  fclose(g_out);
+  return 0;
+}
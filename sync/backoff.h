@@ -0,0 +1,51 @@
+#pragma once
+// 自旋等待用的 pause 和指数退避
+#include <sched.h>
+
+namespace concurrency {
+
+// 告诉 CPU 正在自旋: 省电，也让同一个核上的另一个超线程多跑一点
+inline void cpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_ia32_pause();
+#elif defined(__aarch64__)
+  asm volatile("yield");
+#endif
+}
+
+// 指数退避: 每次 pause 的次数翻倍，到上限之后每次都让出 CPU，
+// 线程数超过核数时持有锁的线程还能被调度到
+class Backoff {
+public:
+  static const unsigned MAX_PAUSES = 1024;
+
+  Backoff() : pauses_(1) {}
+
+  inline void pause() {
+    if (pauses_ > MAX_PAUSES) {
+      sched_yield();
+      return;
+    }
+    for (unsigned i = 0; i < pauses_; i++) {
+      cpuRelax();
+    }
+    pauses_ <<= 1;
+  }
+
+private:
+  unsigned pauses_;
+};
+
+// 等待 cond() 为 true: 先 pause，自旋 MAX_PAUSES 次之后每次都让出 CPU
+// 适合在只有自己会读的缓存行上等 (队列锁的节点)，不需要退避
+template <typename Cond> inline void spinUntil(Cond cond) {
+  unsigned spins = 0;
+  while (!cond()) {
+    cpuRelax();
+    if (++spins > Backoff::MAX_PAUSES) {
+      sched_yield();
+    }
+  }
+}
+
+} // namespace concurrency
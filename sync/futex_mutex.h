@@ -0,0 +1,74 @@
+#pragma once
+// 基于 futex 的互斥锁，满足 Lockable:
+//   FutexMutex   Drepper 的三状态锁，拿不到锁就睡眠，没有人等时 unlock 不进内核
+//   HybridMutex  先自旋一会儿，锁很快被释放时不用睡眠；还拿不到再睡眠
+// 只用于 Linux
+#include <atomic>
+
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "backoff.h"
+
+namespace concurrency {
+
+// 0 空闲，1 被持有且没有人等，2 被持有并且可能有人在等
+// 见 Ulrich Drepper, "Futexes Are Tricky" 中的 mutex2
+// Spins 是睡眠之前最多自旋的次数
+template <unsigned Spins> class BasicFutexMutex {
+public:
+  BasicFutexMutex() : state_(0) {}
+  BasicFutexMutex(const BasicFutexMutex &) = delete;
+  BasicFutexMutex &operator=(const BasicFutexMutex &) = delete;
+
+  inline void lock() {
+    if (try_lock()) {
+      return;
+    }
+    lockSlow_();
+  }
+
+  inline bool try_lock() {
+    int c = 0;
+    return state_.compare_exchange_strong(c, 1, std::memory_order_acquire,
+                                          std::memory_order_relaxed);
+  }
+
+  inline void unlock() {
+    if (state_.exchange(0, std::memory_order_release) == 2) {
+      futex_(FUTEX_WAKE_PRIVATE, 1);
+    }
+  }
+
+private:
+  std::atomic<int> state_;
+
+  void lockSlow_() {
+    for (unsigned i = 0; i < Spins; i++) {
+      cpuRelax();
+      // 已经有人在睡眠，不再自旋，排到它们后面
+      int c = state_.load(std::memory_order_relaxed);
+      if (c == 2) {
+        break;
+      }
+      if (c == 0 && try_lock()) {
+        return;
+      }
+    }
+    int c = state_.exchange(2, std::memory_order_acquire);
+    while (c != 0) {
+      futex_(FUTEX_WAIT_PRIVATE, 2);
+      c = state_.exchange(2, std::memory_order_acquire);
+    }
+  }
+
+  inline void futex_(int op, int val) {
+    syscall(SYS_futex, reinterpret_cast<int *>(&state_), op, val, nullptr, nullptr, 0);
+  }
+};
+
+typedef BasicFutexMutex<0> FutexMutex;
+typedef BasicFutexMutex<128> HybridMutex;
+
+} // namespace concurrency
@@ -0,0 +1,158 @@
+#pragma once
+// 队列锁:
+//   MCSLock  每个等待者在自己的节点上自旋，前一个持有者释放时改它的节点，满足 Lockable
+//   CLHLock  每个等待者在前一个节点上自旋，只满足 BasicLockable (没有 try_lock):
+//            看到的 tail_ 节点可能已经被别的线程回收、重新入队甚至释放，
+//            不排队就判断锁是否空闲会有 ABA 问题
+// 等待的线程各自在不同的缓存行上自旋，释放锁只会让下一个等待者的缓存行失效，
+// 线程多的时候比 TAS/TTAS 好；严格先来先得，排在前面的线程被换出时后面所有人都要等
+#include <atomic>
+#include <cstdlib> // for posix_memalign, free
+#include <new>
+
+#include "backoff.h"
+
+namespace concurrency {
+
+// MCS/CLH 的队列节点，独占一个缓存行
+struct alignas(64) QNode {
+  std::atomic<QNode *> next;
+  std::atomic<bool> locked;
+};
+
+// 每个线程缓存用过的节点，线程退出时释放
+// CLH 的节点会在线程之间流转: 释放锁时拿走前一个节点，自己的节点留给后继
+class QNodeCache {
+public:
+  static QNode *get() {
+    Cache_ &cache = cache_();
+    QNode *node = cache.head;
+    if (node == nullptr) {
+      void *mem = nullptr;
+      if (posix_memalign(&mem, alignof(QNode), sizeof(QNode)) != 0) {
+        throw std::bad_alloc();
+      }
+      return ::new (mem) QNode;
+    }
+    cache.head = node->next.load(std::memory_order_relaxed);
+    return node;
+  }
+
+  static void put(QNode *node) {
+    Cache_ &cache = cache_();
+    node->next.store(cache.head, std::memory_order_relaxed);
+    cache.head = node;
+  }
+
+  static void destroy(QNode *node) {
+    node->~QNode();
+    free(node);
+  }
+
+private:
+  struct Cache_ {
+    QNode *head = nullptr;
+    ~Cache_() {
+      while (head != nullptr) {
+        QNode *next = head->next.load(std::memory_order_relaxed);
+        destroy(head);
+        head = next;
+      }
+    }
+  };
+
+  static Cache_ &cache_() {
+    static thread_local Cache_ cache;
+    return cache;
+  }
+};
+
+class MCSLock {
+public:
+  MCSLock() : tail_(nullptr), holder_(nullptr) {}
+  MCSLock(const MCSLock &) = delete;
+  MCSLock &operator=(const MCSLock &) = delete;
+
+  void lock() {
+    QNode *node = QNodeCache::get();
+    node->next.store(nullptr, std::memory_order_relaxed);
+    node->locked.store(true, std::memory_order_relaxed);
+    QNode *pred = tail_.exchange(node, std::memory_order_acq_rel);
+    if (pred != nullptr) {
+      pred->next.store(node, std::memory_order_release);
+      spinUntil([node] { return !node->locked.load(std::memory_order_acquire); });
+    }
+    holder_ = node;
+  }
+
+  bool try_lock() {
+    QNode *node = QNodeCache::get();
+    node->next.store(nullptr, std::memory_order_relaxed);
+    QNode *expected = nullptr;
+    if (!tail_.compare_exchange_strong(expected, node, std::memory_order_acq_rel,
+                                       std::memory_order_relaxed)) {
+      QNodeCache::put(node);
+      return false;
+    }
+    holder_ = node;
+    return true;
+  }
+
+  void unlock() {
+    QNode *node = holder_;
+    QNode *next = node->next.load(std::memory_order_acquire);
+    if (next == nullptr) {
+      QNode *expected = node;
+      if (tail_.compare_exchange_strong(expected, nullptr, std::memory_order_acq_rel,
+                                        std::memory_order_relaxed)) {
+        QNodeCache::put(node);
+        return;
+      }
+      // 后继已经换了 tail_，但还没来得及挂到 node->next 上
+      while ((next = node->next.load(std::memory_order_acquire)) == nullptr) {
+        cpuRelax();
+      }
+    }
+    next->locked.store(false, std::memory_order_release);
+    QNodeCache::put(node);
+  }
+
+private:
+  alignas(64) std::atomic<QNode *> tail_;
+  // 持有锁的线程的节点，只有持有者访问；每次交接都要写，单独放一个缓存行，
+  // 不和其他线程正在 exchange 的 tail_ 抢同一行
+  alignas(64) QNode *holder_;
+};
+
+class CLHLock {
+public:
+  CLHLock() : tail_(QNodeCache::get()), holder_(nullptr), pred_(nullptr) {
+    tail_.load(std::memory_order_relaxed)->locked.store(false, std::memory_order_relaxed);
+  }
+  CLHLock(const CLHLock &) = delete;
+  CLHLock &operator=(const CLHLock &) = delete;
+  ~CLHLock() { QNodeCache::destroy(tail_.load(std::memory_order_relaxed)); }
+
+  void lock() {
+    QNode *node = QNodeCache::get();
+    node->locked.store(true, std::memory_order_relaxed);
+    QNode *pred = tail_.exchange(node, std::memory_order_acq_rel);
+    spinUntil([pred] { return !pred->locked.load(std::memory_order_acquire); });
+    holder_ = node;
+    pred_ = pred;
+  }
+
+  void unlock() {
+    QNode *pred = pred_;
+    holder_->locked.store(false, std::memory_order_release);
+    QNodeCache::put(pred);
+  }
+
+private:
+  alignas(64) std::atomic<QNode *> tail_;
+  // 持有锁的线程的节点和它前一个节点，只有持有者访问；和 MCSLock 一样不和 tail_ 放在同一行
+  alignas(64) QNode *holder_;
+  QNode *pred_;
+};
+
+} // namespace concurrency
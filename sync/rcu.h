@@ -0,0 +1,150 @@
+#pragma once
+// 基于 epoch 的 RCU: 读很多、写很少的大对象 (合约表、整份配置)
+//   RcuPtr<Table> table(new Table(...));
+//   {
+//     RcuReadLock guard;
+//     const Table *t = table.read(); // guard 的作用域内 t 一直有效
+//   }
+//   table.update(new Table(...));    // 等所有可能还在用旧对象的读者离开，再删掉旧对象
+//
+// 写者换指针，读者永远读到旧的或者新的完整对象，不用拷贝，也不用重试。
+// 读者进入时在自己的记录上写下当前的 epoch，离开时清零；写者换完指针把全局 epoch 加一，
+// 然后只等记录中的 epoch 比新 epoch 小的读者，换完指针之后才进来的读者不用等，
+// 读者一直不断时写者也不会饿死。
+// 读者只写自己独占缓存行的记录，不写任何共享的内存；写者要等读者，所以 update 很慢。
+//
+// 所有 RcuPtr 共用一个全局的 epoch 和读者记录表，读者可以在一个 guard 里读多个 RcuPtr，
+// guard 可以嵌套。guard 中不能调用 update，否则会等自己。
+#include <atomic>
+#include <cstdint> // for uint64_t
+#include <mutex>
+
+#include "backoff.h"
+
+namespace concurrency {
+
+class RcuDomain {
+public:
+  static RcuDomain &instance() {
+    static RcuDomain domain;
+    return domain;
+  }
+
+  inline void readLock() {
+    Record_ *rec = local_();
+    if (rec->nesting++ == 0) {
+      // acquire: 读到写者加过的 epoch，就一定能看到它换上的新指针；
+      // seq_cst 的 store: 写下 epoch 之后才能读指针，写者要么看到这个记录，要么读者看到新指针。
+      // 只靠 store 的 seq_cst 不够: relaxed 读到新 epoch 时，写者不会等这个读者，
+      // 读者却可能还读到旧指针，旧对象被删掉之后还在用
+      rec->epoch.store(epoch_.load(std::memory_order_acquire), std::memory_order_seq_cst);
+    }
+  }
+
+  inline void readUnlock() {
+    Record_ *rec = local_();
+    if (--rec->nesting == 0) {
+      rec->epoch.store(0, std::memory_order_release);
+    }
+  }
+
+  // 等待调用之前开始的读者全部离开
+  void synchronize() {
+    uint64_t target = epoch_.fetch_add(1, std::memory_order_seq_cst) + 1;
+    // seq_cst: 漏掉的新记录上的读者一定看得到新指针
+    for (Record_ *rec = head_.load(std::memory_order_seq_cst); rec != nullptr; rec = rec->next) {
+      spinUntil([rec, target] {
+        uint64_t e = rec->epoch.load(std::memory_order_seq_cst);
+        return e == 0 || e >= target;
+      });
+    }
+  }
+
+private:
+  // 每个线程一条记录，挂在只增不减的链表上，线程退出后留给新线程复用
+  struct alignas(64) Record_ {
+    std::atomic<uint64_t> epoch; // 0 表示不在读
+    std::atomic<bool> used;
+    unsigned nesting; // 只有拥有者访问
+    Record_ *next;
+  };
+
+  // 线程退出时把记录还回去
+  struct Handle_ {
+    Record_ *rec = nullptr;
+    ~Handle_() {
+      if (rec != nullptr) {
+        rec->used.store(false, std::memory_order_release);
+      }
+    }
+  };
+
+  std::atomic<uint64_t> epoch_;
+  alignas(64) std::atomic<Record_ *> head_;
+
+  RcuDomain() : epoch_(1), head_(nullptr) {}
+
+  // 记录表和单例一样不释放: 线程退出的顺序不确定，其他线程的 Handle_ 可能比它活得更久
+  inline Record_ *local_() {
+    static thread_local Handle_ handle;
+    if (handle.rec == nullptr) {
+      handle.rec = acquire_();
+    }
+    return handle.rec;
+  }
+
+  Record_ *acquire_() {
+    for (Record_ *rec = head_.load(std::memory_order_acquire); rec != nullptr; rec = rec->next) {
+      bool expected = false;
+      if (!rec->used.load(std::memory_order_relaxed) &&
+          rec->used.compare_exchange_strong(expected, true, std::memory_order_acquire)) {
+        return rec;
+      }
+    }
+    Record_ *rec = new Record_;
+    rec->epoch.store(0, std::memory_order_relaxed);
+    rec->used.store(true, std::memory_order_relaxed);
+    rec->nesting = 0;
+    rec->next = head_.load(std::memory_order_relaxed);
+    while (!head_.compare_exchange_weak(rec->next, rec, std::memory_order_seq_cst,
+                                        std::memory_order_relaxed)) {
+    }
+    return rec;
+  }
+};
+
+// 读者的作用域
+class RcuReadLock {
+public:
+  RcuReadLock() { RcuDomain::instance().readLock(); }
+  ~RcuReadLock() { RcuDomain::instance().readUnlock(); }
+  RcuReadLock(const RcuReadLock &) = delete;
+  RcuReadLock &operator=(const RcuReadLock &) = delete;
+};
+
+// 只能用 new 出来的对象，RcuPtr 负责删除
+template <typename T> class RcuPtr {
+public:
+  explicit RcuPtr(T *ptr = nullptr) : ptr_(ptr) {}
+  RcuPtr(const RcuPtr &) = delete;
+  RcuPtr &operator=(const RcuPtr &) = delete;
+  // 调用者保证没有读者了
+  ~RcuPtr() { delete ptr_.load(std::memory_order_relaxed); }
+
+  // 必须在 RcuReadLock 的作用域里调用，返回的指针在作用域结束之前有效
+  inline const T *read() const { return ptr_.load(std::memory_order_seq_cst); }
+
+  // 换上新对象，等旧对象没有读者之后删除它；多个写者之间互斥
+  void update(T *ptr) {
+    std::lock_guard<std::mutex> lg(writer_);
+    T *old = ptr_.exchange(ptr, std::memory_order_seq_cst);
+    RcuDomain::instance().synchronize();
+    delete old;
+  }
+
+private:
+  std::atomic<T *> ptr_;
+  std::mutex writer_;
+};
+
+} // namespace concurrency
@@ -0,0 +1,83 @@
+#pragma once
+// 顺序锁: 读很多、写很少的小块数据 (几十个字节的配置、行情快照)
+//   SeqLock<Quote> quote;
+//   quote.store(q);        // 写
+//   Quote q = quote.load(); // 读，读到的一定是某一次 store 的完整内容
+//
+// 写之前把序号加成奇数，写完再加成偶数；读的时候记下序号，拷贝一份，
+// 再检查序号没有变过而且不是奇数，否则重读。
+// 读者只读共享内存，读者之间不会互相让缓存行失效，读者再多也不影响写者；
+// 代价是写得频繁时读者要重试，而且每次读都要拷贝整个 T，所以 T 要小。
+//
+// 数据按 8 字节拆成 relaxed 的原子变量存放，读到一半被改写不算数据竞争，
+// 在 x86 上就是普通的 mov。多个写者之间用 Lock 互斥。
+#include <atomic>
+#include <cstddef> // for size_t
+#include <cstdint> // for uint64_t
+#include <cstring> // for memcpy
+#include <mutex>
+#include <type_traits>
+
+#include "backoff.h"
+#include "spinlock.h"
+
+namespace concurrency {
+
+template <typename T, typename Lock = SpinLock> class SeqLock {
+public:
+  SeqLock() : seq_(0) { store(T()); }
+  explicit SeqLock(const T &value) : seq_(0) { store(value); }
+  SeqLock(const SeqLock &) = delete;
+  SeqLock &operator=(const SeqLock &) = delete;
+
+  T load() const {
+    uint64_t buf[WORDS];
+    Backoff backoff;
+    for (;;) {
+      uint64_t seq = seq_.load(std::memory_order_acquire);
+      if ((seq & 1) == 0) {
+        for (size_t i = 0; i < WORDS; i++) {
+          buf[i] = words_[i].load(std::memory_order_relaxed);
+        }
+        // 拷贝不能排到下面再读序号之后
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (seq_.load(std::memory_order_relaxed) == seq) {
+          break;
+        }
+      }
+      backoff.pause();
+    }
+    T value;
+    memcpy(&value, buf, sizeof(T));
+    return value;
+  }
+
+  void store(const T &value) {
+    uint64_t buf[WORDS] = {};
+    memcpy(buf, &value, sizeof(T));
+    std::lock_guard<Lock> lg(lock_);
+    uint64_t seq = seq_.load(std::memory_order_relaxed);
+    seq_.store(seq + 1, std::memory_order_relaxed);
+    // 数据不能排到序号变成奇数之前
+    std::atomic_thread_fence(std::memory_order_release);
+    for (size_t i = 0; i < WORDS; i++) {
+      words_[i].store(buf[i], std::memory_order_relaxed);
+    }
+    seq_.store(seq + 2, std::memory_order_release);
+  }
+
+  // 一共 store 了几次
+  inline uint64_t version() const { return seq_.load(std::memory_order_acquire) >> 1; }
+
+private:
+  static_assert(std::is_trivially_copyable<T>::value, "SeqLock needs a trivially copyable T.");
+  static_assert(std::is_default_constructible<T>::value,
+                "SeqLock needs a default constructible T.");
+  static const size_t WORDS = (sizeof(T) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+
+  std::atomic<uint64_t> seq_;
+  std::atomic<uint64_t> words_[WORDS];
+  Lock lock_;
+};
+
+} // namespace concurrency
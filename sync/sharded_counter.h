@@ -0,0 +1,146 @@
+#pragma once
+// 分片的计数器和统计量: 写的时候只碰自己那一片，读的时候把所有分片加起来
+//   ShardedCounter<>  add(n) 很便宜，read() 要扫一遍所有分片
+//   ShardedGauge<>    record(v) 记录一个值，read() 得到个数、和、最小值、最大值
+//
+// 所有线程都 fetch_add 同一个 std::atomic 时，这个缓存行在核之间来回传，线程越多越慢。
+// 分片之后每片独占一个缓存行，线程少于分片数时基本不会有两个核写同一片。
+//
+// 分片的选法:
+//   ThreadShard  每个线程第一次使用时领一个编号 (默认)，只是读一个 thread_local
+//   CpuShard     当前所在的 CPU (sched_getcpu，新的 glibc 直接读 rseq 的 cpu_id)，
+//                线程比核多很多时冲突更少，但线程可能在两次操作之间换核
+// 不同的线程可能落在同一片上，所以分片上仍然用原子操作，只是几乎没有竞争
+#include <atomic>
+#include <cstddef> // for size_t
+#include <cstdint> // for int64_t
+#include <limits>
+
+#include <sched.h>
+
+namespace concurrency {
+
+struct ThreadShard {
+  static inline unsigned get() {
+    static std::atomic<unsigned> next(0);
+    static thread_local unsigned shard = next.fetch_add(1, std::memory_order_relaxed);
+    return shard;
+  }
+};
+
+struct CpuShard {
+  static inline unsigned get() {
+    int cpu = sched_getcpu();
+    return cpu < 0 ? 0 : static_cast<unsigned>(cpu);
+  }
+};
+
+// Shards 必须是 2 的幂
+template <size_t Shards = 64, typename Shard = ThreadShard>
+class ShardedCounter {
+public:
+  ShardedCounter() { reset(); }
+  ShardedCounter(const ShardedCounter &) = delete;
+  ShardedCounter &operator=(const ShardedCounter &) = delete;
+
+  // 只用来统计时 relaxed 就够了；用计数来等别的线程做完某件事时，
+  // 做完的一方用 release，等待的一方 read(std::memory_order_acquire)
+  inline void add(int64_t n = 1, std::memory_order order = std::memory_order_relaxed) {
+    slots_[Shard::get() & (Shards - 1)].value.fetch_add(n, order);
+  }
+  inline void sub(int64_t n = 1, std::memory_order order = std::memory_order_relaxed) {
+    add(-n, order);
+  }
+
+  // 不是某一时刻的快照: 扫描期间还在 add 的话，结果介于扫描开始和结束时的值之间
+  int64_t read(std::memory_order order = std::memory_order_relaxed) const {
+    int64_t sum = 0;
+    for (const Slot_ &slot : slots_) {
+      sum += slot.value.load(order);
+    }
+    return sum;
+  }
+
+  // 调用者保证没有人同时 add
+  void reset() {
+    for (Slot_ &slot : slots_) {
+      slot.value.store(0, std::memory_order_relaxed);
+    }
+  }
+
+private:
+  static_assert((Shards & (Shards - 1)) == 0, "Shards must be a power of 2.");
+
+  struct alignas(64) Slot_ {
+    std::atomic<int64_t> value;
+  };
+  Slot_ slots_[Shards];
+};
+
+struct GaugeSnapshot {
+  int64_t count;
+  int64_t sum;
+  int64_t min; // count 为 0 时 min/max 没有意义
+  int64_t max;
+
+  inline double mean() const { return count == 0 ? 0 : static_cast<double>(sum) / count; }
+};
+
+template <size_t Shards = 64, typename Shard = ThreadShard>
+class ShardedGauge {
+public:
+  ShardedGauge() { reset(); }
+  ShardedGauge(const ShardedGauge &) = delete;
+  ShardedGauge &operator=(const ShardedGauge &) = delete;
+
+  inline void record(int64_t v) {
+    Slot_ &slot = slots_[Shard::get() & (Shards - 1)];
+    slot.count.fetch_add(1, std::memory_order_relaxed);
+    slot.sum.fetch_add(v, std::memory_order_relaxed);
+    // 先读一次，大多数时候不用改，也就不用 CAS
+    int64_t cur = slot.min.load(std::memory_order_relaxed);
+    while (v < cur && !slot.min.compare_exchange_weak(cur, v, std::memory_order_relaxed)) {
+    }
+    cur = slot.max.load(std::memory_order_relaxed);
+    while (v > cur && !slot.max.compare_exchange_weak(cur, v, std::memory_order_relaxed)) {
+    }
+  }
+
+  // 和 ShardedCounter::read 一样不是严格的快照，各个字段之间也可能差几次 record
+  GaugeSnapshot read() const {
+    GaugeSnapshot s = {0, 0, std::numeric_limits<int64_t>::max(),
+                       std::numeric_limits<int64_t>::min()};
+    for (const Slot_ &slot : slots_) {
+      s.count += slot.count.load(std::memory_order_relaxed);
+      s.sum += slot.sum.load(std::memory_order_relaxed);
+      int64_t lo = slot.min.load(std::memory_order_relaxed);
+      int64_t hi = slot.max.load(std::memory_order_relaxed);
+      s.min = lo < s.min ? lo : s.min;
+      s.max = hi > s.max ? hi : s.max;
+    }
+    return s;
+  }
+
+  // 调用者保证没有人同时 record
+  void reset() {
+    for (Slot_ &slot : slots_) {
+      slot.count.store(0, std::memory_order_relaxed);
+      slot.sum.store(0, std::memory_order_relaxed);
+      slot.min.store(std::numeric_limits<int64_t>::max(), std::memory_order_relaxed);
+      slot.max.store(std::numeric_limits<int64_t>::min(), std::memory_order_relaxed);
+    }
+  }
+
+private:
+  static_assert((Shards & (Shards - 1)) == 0, "Shards must be a power of 2.");
+
+  struct alignas(64) Slot_ {
+    std::atomic<int64_t> count;
+    std::atomic<int64_t> sum;
+    std::atomic<int64_t> min;
+    std::atomic<int64_t> max;
+  };
+  Slot_ slots_[Shards];
+};
+
+} // namespace concurrency
@@ -0,0 +1,102 @@
+#pragma once
+// 自旋锁，都满足 Lockable (lock/unlock/try_lock)，可以直接用 std::lock_guard/std::unique_lock
+//   TASLock     test_and_set 自旋，失败后指数退避
+//   TTASLock    先读到锁空闲再 test_and_set，等待时只读自己缓存中的副本 (SpinLock)
+//   TicketLock  排队取号，按先来后到获得锁，退避时间和前面的人数成正比
+// 临界区很短、线程数不超过核数时比 std::mutex 快；持有锁的线程被换出时其他线程会白白自旋
+#include <atomic>
+#include <cstdint> // for uint32_t
+
+#include "backoff.h"
+
+namespace concurrency {
+
+class TASLock {
+public:
+  TASLock() : locked_(false) {}
+  TASLock(const TASLock &) = delete;
+  TASLock &operator=(const TASLock &) = delete;
+
+  inline void lock() {
+    Backoff backoff;
+    while (locked_.exchange(true, std::memory_order_acquire)) {
+      backoff.pause();
+    }
+  }
+  inline bool try_lock() { return !locked_.exchange(true, std::memory_order_acquire); }
+  inline void unlock() { locked_.store(false, std::memory_order_release); }
+
+private:
+  std::atomic<bool> locked_;
+};
+
+class TTASLock {
+public:
+  TTASLock() : locked_(false) {}
+  TTASLock(const TTASLock &) = delete;
+  TTASLock &operator=(const TTASLock &) = delete;
+
+  inline void lock() {
+    Backoff backoff;
+    for (;;) {
+      if (!locked_.exchange(true, std::memory_order_acquire)) {
+        return;
+      }
+      // 只读不写，锁被持有期间缓存行一直是共享状态
+      while (locked_.load(std::memory_order_relaxed)) {
+        backoff.pause();
+      }
+    }
+  }
+  inline bool try_lock() {
+    return !locked_.load(std::memory_order_relaxed) &&
+           !locked_.exchange(true, std::memory_order_acquire);
+  }
+  inline void unlock() { locked_.store(false, std::memory_order_release); }
+
+private:
+  std::atomic<bool> locked_;
+};
+
+// 默认的自旋锁
+typedef TTASLock SpinLock;
+
+class TicketLock {
+public:
+  TicketLock() : next_(0), serving_(0) {}
+  TicketLock(const TicketLock &) = delete;
+  TicketLock &operator=(const TicketLock &) = delete;
+
+  inline void lock() {
+    uint32_t ticket = next_.fetch_add(1, std::memory_order_relaxed);
+    unsigned spins = 0;
+    for (;;) {
+      uint32_t serving = serving_.load(std::memory_order_acquire);
+      if (serving == ticket) {
+        return;
+      }
+      // 前面还有 ticket - serving 个人，每人大概要等一个临界区的时间
+      for (uint32_t i = (ticket - serving) * 64; i > 0; i--) {
+        cpuRelax();
+      }
+      if (++spins > Backoff::MAX_PAUSES) {
+        sched_yield();
+      }
+    }
+  }
+  inline bool try_lock() {
+    uint32_t ticket = serving_.load(std::memory_order_acquire);
+    return next_.compare_exchange_strong(ticket, ticket + 1, std::memory_order_acquire,
+                                         std::memory_order_relaxed);
+  }
+  inline void unlock() {
+    serving_.store(serving_.load(std::memory_order_relaxed) + 1,
+                   std::memory_order_release);
+  }
+
+private:
+  std::atomic<uint32_t> next_;
+  std::atomic<uint32_t> serving_;
+};
+
+} // namespace concurrency
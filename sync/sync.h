@@ -0,0 +1,5 @@
+#pragma once
+// 全部的锁，见 README.md
+#include "futex_mutex.h"
+#include "queue_lock.h"
+#include "spinlock.h"